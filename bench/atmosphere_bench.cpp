@@ -0,0 +1,117 @@
+// cost and accuracy of the precomputed scattering tables against a brute
+// force ray march of the same atmosphere.  both run on the CPU: the table
+// path is the lookup code the shader mirrors, the reference marches the view
+// ray and the light path to the sun at every step.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+#include "atmosphere.hpp"
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using std::cout;
+using std::string;
+
+struct ray {
+	glm::vec3 camera, view, sun;
+};
+
+int main(int ac, char * av[]) {
+	size_t rays = 20000;
+	int steps = 256, sun_steps = 64;
+	size_t threads = ThreadPool::default_size();
+
+	options_description desc("options");
+	desc.add_options()
+		("help,h", "prints this message")
+		("rays", value(&rays), "random view rays to compare")
+		("steps", value(&steps), "reference samples along each view ray")
+		("sun-steps", value(&sun_steps), "reference samples along each light path")
+		("threads", value(&threads), "precompute threads")
+	;
+	variables_map vm;
+	store(parse_command_line(ac, av, desc), vm);
+
+	if(vm.count("help")) {
+		cout << desc << "\n";
+		return 0;
+	}
+
+	notify(vm);
+
+	Atmosphere atmosphere(AtmosphereParameters::jupiter());
+	{
+		ThreadPool pool(threads);
+		auto started = std::chrono::steady_clock::now();
+		atmosphere.precompute(pool);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+		printf("precompute on %zu threads: %.2fs\n", pool.size(), seconds);
+	}
+
+	// cameras from inside the atmosphere out to a few radii, every ray
+	// passing through the atmosphere
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> uniform(-1.f, 1.f);
+	auto direction = [&]() {
+		for(;;) {
+			glm::vec3 d(uniform(rng), uniform(rng), uniform(rng));
+			float l = glm::length(d);
+			if(l > 0.01f && l <= 1.f) return d / l;
+		}
+	};
+	float top = atmosphere.parameters().top_radius;
+	std::uniform_real_distribution<float> altitude(1.001f, 3.f);
+	std::vector<ray> samples;
+	while(samples.size() < rays) {
+		ray s = { direction() * altitude(rng), direction(), direction() };
+		float rmu = glm::dot(s.camera, s.view);
+		float r = glm::length(s.camera);
+		if(r > top && (rmu > 0.f || rmu * rmu - r * r + top * top < 0.f)) continue;
+		samples.push_back(s);
+	}
+
+	std::vector<glm::vec3> table(rays), marched(rays);
+	glm::vec3 t;
+
+	auto started = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < rays; i++) {
+		table[i] = atmosphere.sky_radiance(samples[i].camera, samples[i].view, samples[i].sun, t);
+	}
+	double table_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	started = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < rays; i++) {
+		marched[i] = atmosphere.marched_sky_radiance(samples[i].camera, samples[i].view, samples[i].sun, steps, sun_steps, t);
+	}
+	double marched_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	// error relative to the brightest sample, so dark rays on the night side
+	// do not dominate
+	float peak = 0.f;
+	for(auto const & m : marched) peak = std::max(peak, std::max(m.x, std::max(m.y, m.z)));
+
+	std::vector<float> errors(rays);
+	double sum = 0.;
+	for(size_t i = 0; i < rays; i++) {
+		glm::vec3 d = table[i] - marched[i];
+		float e = std::max(std::abs(d.x), std::max(std::abs(d.y), std::abs(d.z))) / peak;
+		errors[i] = e;
+		sum += e;
+	}
+	std::sort(errors.begin(), errors.end());
+
+	printf("%zu rays, reference %d view x %d sun samples\n", rays, steps, sun_steps);
+	printf("tables:    %8.3fus per ray, 1 transmittance and 4 scattering fetches\n", table_seconds / rays * 1e6);
+	printf("reference: %8.3fus per ray = %.0fx the tables\n", marched_seconds / rays * 1e6, marched_seconds / table_seconds);
+	printf("error relative to peak radiance: mean %.4f, p50 %.4f, p99 %.4f, max %.4f\n",
+	    sum / rays, errors[rays / 2], errors[rays * 99 / 100], errors.back());
+
+	return 0;
+}
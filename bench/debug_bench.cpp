@@ -0,0 +1,104 @@
+// cost of the GL debug message callback to the thread the driver calls it
+// on, under a flood of messages: printing each one there as it arrives
+// against queueing it for DebugMessageLog's thread.  reports nanoseconds per
+// message and, for the log, how many were dropped with the ring full.
+// output goes to /dev/null, so the printing cost is formatting and the
+// write call, not a terminal.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <cstdio>
+
+#include "debug_messages.hpp"
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using std::cout;
+
+namespace {
+
+// what the callback used to do
+void GLAPIENTRY print_callback(GLenum, GLenum type, GLuint, GLenum severity,
+                               GLsizei, GLchar const * message, void const * out)
+{
+	fprintf((FILE *)out, "GL CALLBACK: %s type = 0x%x, severity = 0x%x, message = %s\n",
+	        (type == GL_DEBUG_TYPE_ERROR ? "** GL ERROR **" : ""), type, severity, message);
+}
+
+// `count` messages from each of `threads` threads, cycling through `ids`
+// message ids.  returns the wall time in seconds
+double flood(GLDEBUGPROC callback, void const * user, size_t threads, size_t count, size_t ids) {
+	std::vector<std::string> texts(ids);
+	for(size_t i = 0; i < ids; i++) {
+		texts[i] = "Buffer object " + std::to_string(i + 1) + " (bound to GL_ARRAY_BUFFER_ARB, usage hint is "
+		           "GL_STREAM_DRAW) will use VIDEO memory as the source for buffer object operations.";
+	}
+
+	auto started = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for(size_t t = 0; t < threads; t++) {
+		workers.emplace_back([&, t]() {
+			for(size_t i = 0; i < count; i++) {
+				size_t id = (i + t) % ids;
+				callback(GL_DEBUG_SOURCE_API, GL_DEBUG_TYPE_OTHER, GLuint(131185 + id), GL_DEBUG_SEVERITY_NOTIFICATION,
+				         GLsizei(texts[id].size()), texts[id].c_str(), user);
+			}
+		});
+	}
+	for(auto & w : workers) w.join();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+}
+
+int main(int ac, char * av[]) {
+	size_t messages = 1000000;
+	std::vector<size_t> thread_counts = { 1, 4 };
+	size_t ids = 8;
+	size_t capacity = 1024;
+
+	options_description desc("options");
+	desc.add_options()
+		("help,h", "prints this message")
+		("messages", value(&messages), "messages sent by each thread")
+		("threads", value(&thread_counts)->multitoken(), "threads sending at once, like a driver calling back from several")
+		("ids", value(&ids), "distinct message ids")
+		("capacity", value(&capacity), "messages the log's ring holds")
+	;
+	variables_map vm;
+	store(parse_command_line(ac, av, desc), vm);
+
+	if(vm.count("help")) {
+		cout << desc << "\n";
+		return 0;
+	}
+
+	notify(vm);
+
+	FILE * null = fopen("/dev/null", "w");
+	if(null == nullptr) {
+		std::cerr << "could not open /dev/null\n";
+		return 1;
+	}
+
+	printf("%8s %10s %12s %12s %12s %10s\n", "threads", "callback", "ns/message", "messages/s", "dropped", "distinct");
+	for(size_t threads : thread_counts) {
+		double seconds = flood(print_callback, null, threads, messages, ids);
+		size_t total = threads * messages;
+		printf("%8zu %10s %12.1f %12.3g %12s %10s\n", threads, "fprintf", seconds * 1e9 / messages, total / seconds, "-", "-");
+
+		DebugMessageLog log(capacity, 0.1, 20, null);
+		seconds = flood(DebugMessageLog::callback, &log, threads, messages, ids);
+		log.stop();
+		printf("%8zu %10s %12.1f %12.3g %12llu %10zu\n", threads, "ring", seconds * 1e9 / messages, total / seconds,
+		    (unsigned long long)log.dropped(), log.distinct());
+	}
+
+	fclose(null);
+	return 0;
+}
@@ -0,0 +1,150 @@
+// event search throughput: every transit, occultation and eclipse of the
+// Galilean moons by Jupiter as seen from the Earth over a decade, serially
+// and on the pool.  reports the events found per second of wall time and
+// the samples taken.  with --mutual the moons' events with each other are
+// searched too, with --verify the events are searched again on a grid ten
+// times finer and any that differ are counted.
+//
+// the bodies are at their real sizes and distances in km, on circular
+// orbits in one plane, with the Earth and Jupiter on circular orbits around
+// the sun.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "events.hpp"
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using std::cout;
+
+namespace {
+
+const double day = 86400.;
+const double jupiter_year = 4332.59 * day;
+const double earth_year = 365.25 * day;
+
+// heliocentric, the same way round as Orbit
+glm::dvec3 around_sun(double radius, double period, double phase, double t) {
+	double angle = phase + 2. * glm::pi<double>() * t / period;
+	return glm::dvec3(radius * std::cos(angle), 0., -radius * std::sin(angle));
+}
+
+glm::dvec3 jupiter_at(double t) { return around_sun(778.5e6, jupiter_year, 0., t); }
+glm::dvec3 earth_at(double t) { return around_sun(149.6e6, earth_year, 1., t); }
+
+// events the two searches do not agree on, start or end more than `slack` apart
+size_t differences(std::vector<Event> const & a, std::vector<Event> const & b, double slack) {
+	size_t matched = 0;
+	for(auto const & e : a) {
+		for(auto const & f : b) {
+			if(f.kind == e.kind && f.body == e.body && f.primary == e.primary &&
+			   std::abs(f.start - e.start) < slack && std::abs(f.end - e.end) < slack) {
+				matched++;
+				break;
+			}
+		}
+	}
+	return a.size() + b.size() - 2 * matched;
+}
+
+}
+
+int main(int ac, char * av[]) {
+	double years = 10.;
+	double step = 600.;
+	double tolerance = 1e-3;
+	size_t threads = ThreadPool::default_size();
+
+	options_description desc("options");
+	desc.add_options()
+		("help,h", "prints this message")
+		("years", value(&years), "simulated years searched")
+		("step", value(&step), "sampling interval, seconds")
+		("tolerance", value(&tolerance), "seconds event times are refined to")
+		("threads", value(&threads), "pool threads")
+		("mutual", "search the moons' events with each other too")
+		("verify", "search again on a finer grid and compare")
+	;
+	variables_map vm;
+	store(parse_command_line(ac, av, desc), vm);
+
+	if(vm.count("help")) {
+		cout << desc << "\n";
+		return 0;
+	}
+
+	notify(vm);
+
+	Scene scene(glm::identity<glm::mat4>());
+	uint32_t jupiter = uint32_t(scene.add({ "jupiter", 71492.f, Orbit(0.f), -1 }));
+	std::vector<uint32_t> moons = {
+		uint32_t(scene.add({ "io", 1821.6f, Orbit(421700.f, 1.769138 * day, 0.3f), int(jupiter) })),
+		uint32_t(scene.add({ "europa", 1560.8f, Orbit(671034.f, 3.551181 * day, 1.9f), int(jupiter) })),
+		uint32_t(scene.add({ "ganymede", 2634.1f, Orbit(1070412.f, 7.154553 * day, 4.1f), int(jupiter) })),
+		uint32_t(scene.add({ "callisto", 2410.3f, Orbit(1882709.f, 16.689018 * day, 5.2f), int(jupiter) })),
+	};
+
+	EventQuery query;
+	query.start = 0.;
+	query.end = years * 365.25 * day;
+	query.step = step;
+	query.tolerance = tolerance;
+	// jupiter is at the scene origin
+	query.viewpoint = [](double t) { return earth_at(t) - jupiter_at(t); };
+	query.sun = [](double t) { return -glm::normalize(jupiter_at(t)); };
+	query.sun_angular_radius = 696000. / 778.5e6;
+	for(uint32_t m : moons) query.pairs.push_back({ m, jupiter });
+	if(vm.count("mutual")) {
+		for(uint32_t a : moons) {
+			for(uint32_t b : moons) {
+				if(a != b) query.pairs.push_back({ a, b });
+			}
+		}
+	}
+
+	size_t contacts = query.pairs.size() * 2;
+	size_t samples = size_t(std::ceil((query.end - query.start) / step)) + 1;
+
+	ThreadPool pool(threads);
+	std::vector<Event> events;
+	printf("%.1f years, %zu pairs, %zu samples per contact\n", years, query.pairs.size(), samples);
+	printf("%8s %8s %12s %10s %12s %14s\n", "threads", "events", "ms", "events/s", "Msamples/s", "speedup");
+	double serial_ms = 0.;
+	for(ThreadPool * p : { (ThreadPool *)nullptr, &pool }) {
+		auto started = std::chrono::steady_clock::now();
+		events = find_events(scene, query, p);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+		if(p == nullptr) serial_ms = ms;
+
+		printf("%8zu %8zu %12.1f %10.0f %12.2f %13.2fx\n", p != nullptr ? p->size() + 1 : 1, events.size(), ms,
+		    events.size() / (ms * 1e-3), double(samples) * contacts / (ms * 1e3), serial_ms / ms);
+	}
+
+	size_t counts[3] = { 0, 0, 0 };
+	for(auto const & e : events) counts[int(e.kind)]++;
+	printf("%zu transits, %zu occultations, %zu eclipses\n", counts[0], counts[1], counts[2]);
+	if(!events.empty()) {
+		Event const & e = events.front();
+		printf("first: %s %s %s from %.3f to %.3f days\n", scene.bodies()[e.body].name.c_str(), event_name(e.kind),
+		    scene.bodies()[e.primary].name.c_str(), e.start / day, e.end / day);
+	}
+
+	if(vm.count("verify")) {
+		EventQuery fine = query;
+		fine.step = step / 10.;
+		auto started = std::chrono::steady_clock::now();
+		std::vector<Event> reference = find_events(scene, fine, &pool);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+		printf("step %.0f s: %zu events in %.1f ms, %zu differ\n", fine.step, reference.size(), ms,
+		    differences(events, reference, 10. * tolerance + 1.));
+	}
+
+	return 0;
+}
@@ -0,0 +1,253 @@
+// micro-benchmarks of the renderer's building blocks, with no display and no
+// GL context: image decode and resize on the img/ assets, the CPU side of
+// TextureArray, uniform and texture dispatch in programParameters, orbits and
+// the per-frame scene math.  the GL entry points GLEW resolves at runtime are
+// pointed at stubs that do nothing, so the dispatch numbers are the cost of
+// the wrappers alone; GL 1.1 calls go to the GL library, which ignores them
+// without a current context.
+//
+// built on Google Benchmark, so results can be kept and compared between
+// builds with its own flags, e.g.
+//
+//   gl_planets_micro_bench --benchmark_format=json --benchmark_out=micro.json
+//
+// anything left after its flags is the directory of the images, ../img by default.
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+
+#include <benchmark/benchmark.h>
+
+#include "gl.hpp"
+#include "scene.hpp"
+
+using std::string;
+
+namespace {
+
+// every GLEW entry point gl.hpp reaches from the benchmarks below
+void stub_gl() {
+	__glewUseProgram = [](GLuint) {};
+	__glewActiveTexture = [](GLenum) {};
+	__glewBindBuffer = [](GLenum, GLuint) {};
+	__glewEnableVertexAttribArray = [](GLuint) {};
+	__glewDisableVertexAttribArray = [](GLuint) {};
+	__glewVertexAttribPointer = [](GLuint, GLint, GLenum, GLboolean, GLsizei, void const *) {};
+	__glewUniform1i = [](GLint, GLint) {};
+	__glewUniform1f = [](GLint, GLfloat) {};
+	__glewUniform1fv = [](GLint, GLsizei, GLfloat const *) {};
+	__glewUniform3fv = [](GLint, GLsizei, GLfloat const *) {};
+	__glewUniform4fv = [](GLint, GLsizei, GLfloat const *) {};
+	__glewUniformMatrix4fv = [](GLint, GLsizei, GLboolean, GLfloat const *) {};
+	// every name gets its own location, as if the program used it
+	__glewGetUniformLocation = [](GLuint, GLchar const *) -> GLint { static GLint next = 0; return next++; };
+	__glewGetAttribLocation = [](GLuint, GLchar const *) -> GLint { static GLint next = 0; return next++; };
+	__glewGenBuffers = [](GLsizei n, GLuint * buffers) { static GLuint next = 1; for(GLsizei i = 0; i < n; i++) buffers[i] = next++; };
+	__glewBufferData = [](GLenum, GLsizeiptr, void const *, GLenum) {};
+	__glewDeleteBuffers = [](GLsizei, GLuint const *) {};
+}
+
+string image_directory = "../img";
+
+std::vector<string> images() {
+	std::vector<string> paths;
+	std::error_code ec;
+	for(auto const & entry : std::filesystem::directory_iterator(image_directory, ec)) {
+		string ext = entry.path().extension().string();
+		if(ext == ".jpg" || ext == ".jpeg" || ext == ".png") paths.push_back(entry.path().string());
+	}
+	std::sort(paths.begin(), paths.end());
+	return paths;
+}
+
+void decode(benchmark::State & state, string const & path) {
+	int w = 0, h = 0, c = 0;
+	for(auto _ : state) {
+		unsigned char * pixels = stbi_load(path.c_str(), &w, &h, &c, 3);
+		if(pixels == nullptr) {
+			state.SkipWithError("could not decode");
+			return;
+		}
+		benchmark::DoNotOptimize(pixels);
+		stbi_image_free(pixels);
+	}
+	state.SetBytesProcessed(state.iterations() * int64_t(w) * h * 3);
+	state.counters["megapixels"] = w * h / 1e6;
+}
+
+void preview(benchmark::State & state, string const & path) {
+	int w = 0, h = 0, c = 0;
+	for(auto _ : state) {
+		unsigned char * pixels = load_preview_image(path, &w, &h, &c, 3);
+		if(pixels == nullptr) {
+			state.SkipWithError("no preview for this format");
+			return;
+		}
+		benchmark::DoNotOptimize(pixels);
+		stbi_image_free(pixels);
+	}
+	state.SetBytesProcessed(state.iterations() * int64_t(w) * h * 3);
+}
+
+// a resize to the width in the argument, keeping the aspect ratio, with
+// stbir or with the resample() TextureArray uses
+void resize(benchmark::State & state, string const & path, bool stbir) {
+	int w, h, c;
+	unsigned char * pixels = stbi_load(path.c_str(), &w, &h, &c, 3);
+	if(pixels == nullptr) {
+		state.SkipWithError("could not decode");
+		return;
+	}
+	int width = int(state.range(0));
+	int height = std::max(1, int(int64_t(width) * h / w));
+	std::vector<unsigned char> out(size_t(width) * height * 3);
+	for(auto _ : state) {
+		if(stbir) {
+			stbir_resize_uint8(pixels, w, h, 0, out.data(), width, height, 0, 3);
+		} else {
+			resample(pixels, w, h, out.data(), width, height, 3, resample_default_filter(w, h, width, height), &resample_pool());
+		}
+		benchmark::DoNotOptimize(out.data());
+	}
+	stbi_image_free(pixels);
+	state.SetBytesProcessed(state.iterations() * int64_t(w) * h * 3);
+}
+
+// TextureArray's decode and resize of the planet layers, everything init()
+// does before it touches GL
+void texture_array_decode(benchmark::State & state, bool full) {
+	std::vector<string> paths = {
+		image_directory + "/io-2.jpg",
+		image_directory + "/io_normal_4096x2048.jpg"
+	};
+	for(auto _ : state) {
+		std::vector<unsigned char *> layers;
+		int width, height;
+		if(!TextureArray::decode(paths, full ? image_loader(load_full_image) : image_loader(load_preview_image), layers, width, height)) {
+			for(auto dat : layers) delete [] dat;
+			state.SkipWithError("could not decode the layers");
+			return;
+		}
+		for(auto dat : layers) delete [] dat;
+	}
+}
+
+// one draw's worth of setters for the sphere program's parameters.  the
+// argument turns the GL state cache on or off
+void program_parameters(benchmark::State & state) {
+	GLState::current().set_enabled(state.range(0) != 0);
+	GLState::current().invalidate();
+
+	const size_t bodies = 16;
+	glm::mat4 mv(1.f);
+	glm::vec3 camera(0.f), sun(1.f, 0.f, 0.f);
+	std::vector<glm::vec3> position(bodies);
+	std::vector<float> radius(bodies, 1.f);
+	std::vector<glm::vec4> occluder(bodies);
+	float count = 0.f, sun_radius = 0.02f;
+	float corners[] = { -1, -1, 1, -1, 1, 1, -1, 1 };
+	std::vector<float> table(4 * 16 * 16, 0.f);
+
+	Program program(1, Shader(), Shader());
+	ArrayBuffer<float,2> corners_buffer(corners);
+	UniformMatrix<float,4> inverse_transform(mv);
+	Uniform<float,3> camera_position(camera);
+	Uniform<float,3> sun_position(sun);
+	UniformArray<float,3> planet_position(position.data(), position.size());
+	UniformArray<float,1> planet_radius(radius.data(), radius.size());
+	UniformArray<float,4> shadow_occluders(occluder.data(), occluder.size());
+	LookupTable lookup_a(table.data(), 16, 16), lookup_b(table.data(), 16, 16);
+
+	auto drawer = program.make_drawer()
+		("camera", camera_position )
+		("sun", sun_position )
+		("inv", inverse_transform )
+		("corner", corners_buffer )
+		("radius", planet_radius )
+		("position", planet_position )
+		("sun_radius", sun_radius )
+		("shadow_occluder", shadow_occluders )
+		("shadow_count", count )
+		("transmittance", lookup_a )
+		("scattering", lookup_b )
+	;
+
+	for(auto _ : state) {
+		drawer.draw_arrays_triangle_fan();
+	}
+	GLState::current().set_enabled(true);
+	state.counters["skipped/draw"] = double(GLState::current().skipped()) / std::max<int64_t>(state.iterations(), 1);
+	GLState::current().reset_counters();
+}
+
+void orbit(benchmark::State & state) {
+	Orbit o(50.f, 120., 0.3f);
+	double t = 0.;
+	for(auto _ : state) {
+		benchmark::DoNotOptimize(o(t));
+		t += 1. / 60.;
+	}
+}
+
+// the matrices main() derives every frame from the projection and camera
+void frame_matrices(benchmark::State & state) {
+	Scene scene(glm::perspective(glm::radians(75.f), 16.f / 9.f, 45.f, 1000.f));
+	double t = 0.;
+	for(auto _ : state) {
+		glm::mat4 view = scene.view_at(t);
+		glm::mat4 view_projection = scene.projection() * view;
+		glm::mat4 inverse_view_projection = glm::inverse(view_projection);
+		glm::vec3 camera = glm::inverse(view) * glm::vec4(0, 0, 0, 1);
+		benchmark::DoNotOptimize(inverse_view_projection);
+		benchmark::DoNotOptimize(camera);
+		t += 1. / 60.;
+	}
+}
+
+// a whole simulation step with the argument's number of bodies
+void scene_update(benchmark::State & state) {
+	Scene scene(glm::perspective(glm::radians(75.f), 16.f / 9.f, 45.f, 1000.f));
+	size_t parent = scene.add({ "jupiter", 35.f, Orbit(50.), -1 });
+	for(int64_t i = 1; i < state.range(0); i++) {
+		scene.add({ "moon", 1.f, Orbit(45.f + i % 80, 20. + i % 180, 0.1f * i), int(parent) });
+	}
+	SceneState scene_state;
+	double t = 0.;
+	for(auto _ : state) {
+		scene.update(t, scene_state);
+		benchmark::DoNotOptimize(scene_state.position.data());
+		t += 1. / 60.;
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+}
+
+int main(int argc, char ** argv) {
+	benchmark::Initialize(&argc, argv);
+	if(argc > 1) image_directory = argv[1];
+
+	stub_gl();
+
+	for(string const & path : images()) {
+		string name = std::filesystem::path(path).filename().string();
+		benchmark::RegisterBenchmark(("stbi_load/" + name).c_str(), decode, path)->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("preview/" + name).c_str(), preview, path)->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("stbir_resize/" + name).c_str(), resize, path, true)
+			->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond);
+		benchmark::RegisterBenchmark(("resample/" + name).c_str(), resize, path, false)
+			->Arg(1024)->Arg(4096)->Unit(benchmark::kMillisecond);
+	}
+	benchmark::RegisterBenchmark("texture_array_decode/preview", texture_array_decode, false)->Unit(benchmark::kMillisecond);
+	benchmark::RegisterBenchmark("texture_array_decode/full", texture_array_decode, true)->Unit(benchmark::kMillisecond);
+	benchmark::RegisterBenchmark("program_parameters/draw", program_parameters)->Arg(0)->Arg(1);
+	benchmark::RegisterBenchmark("orbit", orbit);
+	benchmark::RegisterBenchmark("frame_matrices", frame_matrices);
+	benchmark::RegisterBenchmark("scene_update", scene_update)->Arg(2)->Arg(64)->Arg(1024);
+
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
@@ -0,0 +1,67 @@
+// ring particle propagation throughput: positions for every particle at a
+// new time, written into the array that gets streamed to the GPU, serially
+// and on the pool.  reports particles per millisecond and the bytes each
+// update streams.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+#include "particles.hpp"
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using std::cout;
+
+int main(int ac, char * av[]) {
+	std::vector<size_t> counts = { 100000, 1000000 };
+	size_t frames = 100;
+	size_t threads = ThreadPool::default_size();
+
+	options_description desc("options");
+	desc.add_options()
+		("help,h", "prints this message")
+		("particles", value(&counts)->multitoken(), "particle counts to run")
+		("frames", value(&frames), "updates timed per run")
+		("threads", value(&threads), "pool threads")
+	;
+	variables_map vm;
+	store(parse_command_line(ac, av, desc), vm);
+
+	if(vm.count("help")) {
+		cout << desc << "\n";
+		return 0;
+	}
+
+	notify(vm);
+
+	ThreadPool pool(threads);
+	printf("%10s %8s %12s %14s %12s\n", "particles", "threads", "ms/update", "particles/ms", "MB/update");
+	for(size_t count : counts) {
+		ParticleField ring = ParticleField::ring(count, 49.f, 63.35f, 0.05f, 8., 0.002f, 0.02f);
+		std::vector<float> xyz(3 * count);
+		glm::vec3 center(50.f, 0.f, 0.f);
+
+		for(ThreadPool * p : { (ThreadPool *)nullptr, &pool }) {
+			// a long way into a run, where the angles are large
+			double t = 1e6;
+			ring.propagate(t, center, xyz.data(), p);
+
+			auto started = std::chrono::steady_clock::now();
+			for(size_t f = 0; f < frames; f++) {
+				t += 1. / 60.;
+				ring.propagate(t, center, xyz.data(), p);
+			}
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count() / frames;
+
+			printf("%10zu %8zu %12.3f %14.0f %12.2f\n", count, p != nullptr ? p->size() + 1 : size_t(1),
+			    ms, count / ms, xyz.size() * sizeof(float) / 1e6);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,146 @@
+// image resampling, the resize every TextureArray layer goes through: time
+// and quality of stbir_resize_uint8 against resample(), scalar and SIMD, on
+// one thread and on the pool.  quality is the PSNR of a round trip, down to
+// the target and back up to the source size with the same resizer, against
+// the source; "vs stbir" is the PSNR of the downsized image against stbir's.
+//
+// runs on an image given with --image, or on a synthetic equirectangular
+// map with smooth shading and fine detail otherwise.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <stb/stb_image.h>
+#include <stb/stb_image_resize.h>
+
+#include "resample.hpp"
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using std::cout;
+
+namespace {
+
+typedef std::function<void(uint8_t const *, int, int, uint8_t *, int, int)> resizer;
+
+std::vector<uint8_t> synthetic(int width, int height) {
+	std::vector<uint8_t> pixels(size_t(width) * height * 3);
+	for(int y = 0; y < height; y++) {
+		for(int x = 0; x < width; x++) {
+			float u = float(x) / width, v = float(y) / height;
+			for(int c = 0; c < 3; c++) {
+				float smooth = 128.f + 70.f * std::sin(6.283f * (u * (c + 1) + v));
+				float detail = 30.f * std::sin(0.9f * x + 0.4f * c) * std::cos(0.7f * y);
+				float edge = ((x / 97 + y / 61) & 1) ? 20.f : -20.f;
+				pixels[(size_t(y) * width + x) * 3 + c] = uint8_t(std::clamp(smooth + detail + edge, 0.f, 255.f));
+			}
+		}
+	}
+	return pixels;
+}
+
+double psnr(std::vector<uint8_t> const & a, std::vector<uint8_t> const & b) {
+	double error = 0.;
+	for(size_t i = 0; i < a.size(); i++) {
+		double d = double(a[i]) - b[i];
+		error += d * d;
+	}
+	error /= a.size();
+	return error == 0. ? 99. : 10. * std::log10(255. * 255. / error);
+}
+
+}
+
+int main(int ac, char * av[]) {
+	std::string image;
+	int width = 4096, height = 2048;
+	std::vector<float> scales = { 0.5f, 0.25f };
+	size_t repeats = 5;
+	size_t threads = ThreadPool::default_size();
+
+	options_description desc("options");
+	desc.add_options()
+		("help,h", "prints this message")
+		("image", value(&image), "image to resize, a synthetic one if not given")
+		("width", value(&width), "width of the synthetic image")
+		("height", value(&height), "height of the synthetic image")
+		("scale", value(&scales)->multitoken(), "target sizes as fractions of the source")
+		("repeats", value(&repeats), "resizes timed per run")
+		("threads", value(&threads), "pool threads")
+	;
+	variables_map vm;
+	store(parse_command_line(ac, av, desc), vm);
+
+	if(vm.count("help")) {
+		cout << desc << "\n";
+		return 0;
+	}
+
+	notify(vm);
+
+	std::vector<uint8_t> source;
+	if(!image.empty()) {
+		int channels;
+		unsigned char * pixels = stbi_load(image.c_str(), &width, &height, &channels, 3);
+		if(pixels == nullptr) {
+			std::cerr << "could not decode '" << image << "'\n";
+			return 1;
+		}
+		source.assign(pixels, pixels + size_t(width) * height * 3);
+		stbi_image_free(pixels);
+	} else {
+		source = synthetic(width, height);
+	}
+
+	ThreadPool pool(threads);
+	std::vector<std::pair<std::string, resizer>> resizers = {
+		{ "stbir", [](uint8_t const * src, int sw, int sh, uint8_t * dst, int dw, int dh) {
+			stbir_resize_uint8(src, sw, sh, 0, dst, dw, dh, 0, 3);
+		} },
+		{ "scalar", [](uint8_t const * src, int sw, int sh, uint8_t * dst, int dw, int dh) {
+			resample(src, sw, sh, dst, dw, dh, 3, resample_default_filter(sw, sh, dw, dh), nullptr, false);
+		} },
+		{ "simd", [](uint8_t const * src, int sw, int sh, uint8_t * dst, int dw, int dh) {
+			resample(src, sw, sh, dst, dw, dh, 3, resample_default_filter(sw, sh, dw, dh));
+		} },
+		{ "simd+pool", [&pool](uint8_t const * src, int sw, int sh, uint8_t * dst, int dw, int dh) {
+			resample(src, sw, sh, dst, dw, dh, 3, resample_default_filter(sw, sh, dw, dh), &pool);
+		} },
+	};
+
+	printf("%dx%d, %zu threads\n", width, height, pool.size() + 1);
+	printf("%12s %10s %10s %10s %12s %10s\n", "target", "resizer", "ms", "MP/s", "round trip", "vs stbir");
+	for(float scale : scales) {
+		int w = std::max(1, int(std::lround(width * scale)));
+		int h = std::max(1, int(std::lround(height * scale)));
+		std::vector<uint8_t> reference(size_t(w) * h * 3);
+		std::vector<uint8_t> down(reference.size()), up(source.size());
+
+		for(auto const & [name, resize] : resizers) {
+			resize(source.data(), width, height, down.data(), w, h);
+
+			auto started = std::chrono::steady_clock::now();
+			for(size_t r = 0; r < repeats; r++) {
+				resize(source.data(), width, height, down.data(), w, h);
+			}
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count() / repeats;
+
+			if(name == "stbir") reference = down;
+			resize(down.data(), w, h, up.data(), width, height);
+
+			char target[32];
+			snprintf(target, sizeof(target), "%dx%d", w, h);
+			printf("%12s %10s %10.2f %10.1f %9.2f dB %7.2f dB\n", target, name.c_str(), ms,
+			    double(width) * height / (ms * 1e3), psnr(source, up), psnr(reference, down));
+		}
+	}
+
+	return 0;
+}
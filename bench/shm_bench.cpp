@@ -0,0 +1,129 @@
+// latency and throughput of the shared memory frame ring, with a synthetic
+// producer standing in for the renderer and a reader thread standing in for
+// a compositor.  the reader maps the ring separately, as another process would.
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+
+#include "shm_ring.hpp"
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using std::cout;
+using std::cerr;
+using std::string;
+
+int main(int ac, char * av[]) {
+	string name = "/gl_planets_bench";
+	uint32_t width = 1920, height = 1080, slots = 3;
+	double rate = 0., seconds = 5.;
+
+	options_description desc("options");
+	desc.add_options()
+		("help,h", "prints this message")
+		("name,n", value(&name), "shared memory object to create")
+		("width", value(&width), "frame width")
+		("height", value(&height), "frame height")
+		("slots", value(&slots), "frames held by the ring")
+		("rate", value(&rate), "frames per second to produce, 0 for as fast as possible")
+		("seconds", value(&seconds), "length of the run")
+	;
+	variables_map vm;
+	store(parse_command_line(ac, av, desc), vm);
+
+	if(vm.count("help")) {
+		cout << desc << "\n";
+		return 0;
+	}
+
+	notify(vm);
+
+	uint32_t stride = width * 4;
+	ShmRingWriter writer;
+	if(!writer.create(name, slots, stride * height)) {
+		return -1;
+	}
+
+	// something that changes every frame, so the copy cannot be elided
+	std::vector<unsigned char> source(size_t(stride) * height);
+	for(size_t i = 0; i < source.size(); i++) source[i] = (unsigned char)(i * 7);
+
+	std::atomic<bool> running(true);
+	std::vector<double> latencies_us;
+	uint64_t consumed = 0, skipped = 0, torn = 0;
+	// printed with the results, which keeps the reads from being optimised away
+	unsigned checksum = 0;
+
+	std::thread consumer([&]() {
+		ShmRingReader reader;
+		if(!reader.open(name)) {
+			cerr << "could not open '" << name << "'\n";
+			return;
+		}
+
+		uint64_t last = 0;
+		while(running) {
+			ShmFrame frame;
+			if(!reader.acquire(frame, last)) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			size_t size = size_t(frame.stride) * frame.height;
+			for(size_t i = 0; i < size; i += 64) checksum += frame.pixels[i];
+
+			if(!reader.still_valid(frame)) {
+				torn++;
+				continue;
+			}
+
+			latencies_us.push_back((monotonic_ns() - frame.timestamp_ns) * 1e-3);
+			if(last != 0) skipped += frame.sequence - last - 1;
+			last = frame.sequence;
+			consumed++;
+		}
+	});
+
+	auto period = std::chrono::duration<double>(rate > 0. ? 1. / rate : 0.);
+	auto started = std::chrono::steady_clock::now();
+	auto next = started;
+	uint64_t produced = 0;
+	while(std::chrono::steady_clock::now() - started < std::chrono::duration<double>(seconds)) {
+		source[produced % source.size()]++;
+		writer.publish(source.data(), width, height, stride, shm_format_rgba8, 0, monotonic_ns());
+		produced++;
+
+		if(rate > 0.) {
+			next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+			std::this_thread::sleep_until(next);
+		}
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	running = false;
+	consumer.join();
+
+	std::sort(latencies_us.begin(), latencies_us.end());
+	auto percentile = [&](double p) {
+		return latencies_us.empty() ? 0. : latencies_us[std::min(latencies_us.size() - 1, size_t(p * latencies_us.size()))];
+	};
+
+	printf("%ux%u RGBA, %u slots, %.1fs\n", width, height, slots, elapsed);
+	printf("produced %llu frames = %.1f frames/s, %.2f GB/s\n",
+	    (unsigned long long)produced, produced / elapsed,
+	    produced * double(stride) * height / elapsed * 1e-9);
+	printf("consumed %llu frames = %.1f frames/s, skipped %llu, torn %llu, checksum %08x\n",
+	    (unsigned long long)consumed, consumed / elapsed,
+	    (unsigned long long)skipped, (unsigned long long)torn, checksum);
+	printf("publish to consume latency p50 %.1fus p99 %.1fus max %.1fus\n",
+	    percentile(0.5), percentile(0.99), latencies_us.empty() ? 0. : latencies_us.back());
+
+	return 0;
+}
@@ -0,0 +1,684 @@
+#ifndef __ATMOSPHERE_HPP__
+#define __ATMOSPHERE_HPP__
+
+#include <glm/glm.hpp>
+#include <glm/ext/scalar_constants.hpp> // glm::pi
+
+#include "thread_pool.hpp"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+// precomputed atmospheric scattering after Bruneton and Neyret 2008, using the
+// parametrisation of Bruneton's 2017 reference implementation.  instead of
+// iterating scattering orders, multiple scattering comes from the 2D transfer
+// table of Hillaire 2020 and is folded into the single scattering table, so
+// the shader samples one transmittance and one scattering table.
+//
+// lengths are in planet radii (the ground is at r = 1) so the tables do not
+// depend on the scene scale and the shader math stays in a small range.
+
+struct AtmosphereParameters {
+	float top_radius;
+	glm::vec3 rayleigh_scattering;  // per planet radius, at the ground
+	float rayleigh_scale_height;
+	float mie_scattering;
+	float mie_extinction;
+	float mie_scale_height;
+	float mie_g;
+	float mu_s_min;                 // sun zenith cosine below which the scattering table is empty
+	float sun_angular_radius;
+	glm::vec3 ground_albedo;        // bounce light off the cloud deck for multiple scattering
+
+	// deep hydrogen haze over the cloud tops, exaggerated about 40x in height
+	// so it reads at the scale the scene is drawn at
+	static AtmosphereParameters jupiter() {
+		AtmosphereParameters p;
+		p.top_radius = 1.08f;
+		p.rayleigh_scale_height = 0.012f;
+		// optical depth at the zenith of roughly 0.05, 0.12 and 0.3
+		p.rayleigh_scattering = glm::vec3(4.4f, 10.f, 25.f);
+		p.mie_scale_height = 0.004f;
+		p.mie_scattering = 20.f;
+		p.mie_extinction = 22.f;
+		p.mie_g = 0.7f;
+		p.mu_s_min = -0.75f;
+		p.sun_angular_radius = 0.005f;
+		p.ground_albedo = glm::vec3(0.55f, 0.5f, 0.42f);
+		return p;
+	}
+
+	uint64_t hash() const {
+		// FNV-1a over the fields, which are all floats
+		uint64_t h = 0xcbf29ce484222325ull;
+		auto add = [&h](float x) {
+			uint32_t bits;
+			memcpy(&bits, &x, sizeof(bits));
+			for(int i = 0; i < 4; i++) {
+				h ^= (bits >> (8 * i)) & 0xff;
+				h *= 0x100000001b3ull;
+			}
+		};
+		add(top_radius);
+		for(int i = 0; i < 3; i++) add(rayleigh_scattering[i]);
+		add(rayleigh_scale_height);
+		add(mie_scattering);
+		add(mie_extinction);
+		add(mie_scale_height);
+		add(mie_g);
+		add(mu_s_min);
+		add(sun_angular_radius);
+		for(int i = 0; i < 3; i++) add(ground_albedo[i]);
+		return h;
+	}
+};
+
+class Atmosphere {
+public:
+	static const int transmittance_width = 256;
+	static const int transmittance_height = 64;
+	static const int multiple_scattering_size = 32;
+	static const int scattering_r = 32;
+	static const int scattering_mu = 128;
+	static const int scattering_mu_s = 32;
+	static const int scattering_nu = 8;
+	// the 4D scattering table is stored as scattering_r layers of this size
+	static const int scattering_width = scattering_nu * scattering_mu_s;
+	static const int scattering_height = scattering_mu;
+
+	static const int transmittance_samples = 500;
+	static const int scattering_samples = 50;
+	static const int multiple_scattering_directions = 64;
+	static const int multiple_scattering_samples = 20;
+
+private:
+	static constexpr uint32_t cache_magic = 0x41504c47; // "GLPA"
+	static constexpr uint32_t cache_version = 1;
+
+	struct cache_header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t hash;
+		int32_t sizes[8];
+	};
+
+	AtmosphereParameters p_;
+	float bottom_;
+	float H_; // distance to the top boundary from the ground, along the horizon
+
+	// RGBA floats, row by row.  transmittance and multiple scattering leave alpha at 0,
+	// scattering keeps the red channel of single Mie scattering there
+	std::vector<float> transmittance_;
+	std::vector<float> multiple_scattering_;
+	std::vector<float> scattering_;
+
+	static float clamp_cosine(float mu) { return std::clamp(mu, -1.f, 1.f); }
+	static float safe_sqrt(float a) { return std::sqrt(std::max(a, 0.f)); }
+	float clamp_radius(float r) const { return std::clamp(r, bottom_, p_.top_radius); }
+
+	static float coord_from_unit_range(float x, int size) { return 0.5f / size + x * (1.f - 1.f / size); }
+	static float unit_range_from_coord(float u, int size) { return (u - 0.5f / size) / (1.f - 1.f / size); }
+
+	static glm::vec3 rgb(glm::vec4 v) { return glm::vec3(v.x, v.y, v.z); }
+	static glm::vec3 exp(glm::vec3 v) { return glm::vec3(std::exp(v.x), std::exp(v.y), std::exp(v.z)); }
+	static glm::vec3 min(glm::vec3 a, glm::vec3 b) { return glm::vec3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)); }
+	static glm::vec3 divide(glm::vec3 a, glm::vec3 b) {
+		auto d = [](float x, float y) { return y > 0.f ? x / y : 0.f; };
+		return glm::vec3(d(a.x, b.x), d(a.y, b.y), d(a.z, b.z));
+	}
+
+	float rayleigh_density(float r) const { return std::exp(-(r - bottom_) / p_.rayleigh_scale_height); }
+	float mie_density(float r) const { return std::exp(-(r - bottom_) / p_.mie_scale_height); }
+	glm::vec3 scattering_at(float r) const {
+		return p_.rayleigh_scattering * rayleigh_density(r) + glm::vec3(p_.mie_scattering * mie_density(r));
+	}
+	glm::vec3 extinction_at(float r) const {
+		return p_.rayleigh_scattering * rayleigh_density(r) + glm::vec3(p_.mie_extinction * mie_density(r));
+	}
+
+	// bilinear lookup with clamp to edge, like the GPU sampler
+	static glm::vec4 sample(std::vector<float> const & table, int width, int height, float u, float v) {
+		float x = std::clamp(u * width - 0.5f, 0.f, width - 1.f);
+		float y = std::clamp(v * height - 0.5f, 0.f, height - 1.f);
+		int x0 = int(x), y0 = int(y);
+		int x1 = std::min(x0 + 1, width - 1), y1 = std::min(y0 + 1, height - 1);
+		float fx = x - x0, fy = y - y0;
+
+		auto texel = [&](int tx, int ty) {
+			float const * t = &table[4 * (size_t(ty) * width + tx)];
+			return glm::vec4(t[0], t[1], t[2], t[3]);
+		};
+		auto lerp = [](glm::vec4 a, glm::vec4 b, float t) { return a * (1.f - t) + b * t; };
+		return lerp(lerp(texel(x0, y0), texel(x1, y0), fx), lerp(texel(x0, y1), texel(x1, y1), fx), fy);
+	}
+
+	glm::vec2 transmittance_uv(float r, float mu) const {
+		float rho = safe_sqrt(r * r - bottom_ * bottom_);
+		float d = distance_to_top(r, mu);
+		float d_min = p_.top_radius - r;
+		float d_max = rho + H_;
+		float x_mu = (d - d_min) / (d_max - d_min);
+		float x_r = rho / H_;
+		return glm::vec2(coord_from_unit_range(x_mu, transmittance_width), coord_from_unit_range(x_r, transmittance_height));
+	}
+
+	void transmittance_r_mu(float u, float v, float & r, float & mu) const {
+		float x_mu = unit_range_from_coord(u, transmittance_width);
+		float x_r = unit_range_from_coord(v, transmittance_height);
+		float rho = H_ * x_r;
+		r = std::sqrt(rho * rho + bottom_ * bottom_);
+		float d_min = p_.top_radius - r;
+		float d_max = rho + H_;
+		float d = d_min + x_mu * (d_max - d_min);
+		mu = d == 0.f ? 1.f : (H_ * H_ - rho * rho - d * d) / (2.f * r * d);
+		mu = clamp_cosine(mu);
+	}
+
+	// (nu, mu_s, mu, r) to [0,1]^4
+	glm::vec4 scattering_uvwz(float r, float mu, float mu_s, float nu, bool ground) const {
+		float rho = safe_sqrt(r * r - bottom_ * bottom_);
+		float u_r = coord_from_unit_range(rho / H_, scattering_r);
+
+		float r_mu = r * mu;
+		float discriminant = r_mu * r_mu - r * r + bottom_ * bottom_;
+		float u_mu;
+		if(ground) {
+			float d = -r_mu - safe_sqrt(discriminant);
+			float d_min = r - bottom_;
+			float d_max = rho;
+			u_mu = 0.5f - 0.5f * coord_from_unit_range(d_max == d_min ? 0.f : (d - d_min) / (d_max - d_min), scattering_mu / 2);
+		} else {
+			float d = -r_mu + safe_sqrt(discriminant + H_ * H_);
+			float d_min = p_.top_radius - r;
+			float d_max = rho + H_;
+			u_mu = 0.5f + 0.5f * coord_from_unit_range((d - d_min) / (d_max - d_min), scattering_mu / 2);
+		}
+
+		float d = distance_to_top(bottom_, mu_s);
+		float d_min = p_.top_radius - bottom_;
+		float d_max = H_;
+		float a = (d - d_min) / (d_max - d_min);
+		float A = (distance_to_top(bottom_, p_.mu_s_min) - d_min) / (d_max - d_min);
+		float u_mu_s = coord_from_unit_range(std::max(1.f - a / A, 0.f) / (1.f + a), scattering_mu_s);
+
+		return glm::vec4((nu + 1.f) / 2.f, u_mu_s, u_mu, u_r);
+	}
+
+	void scattering_r_mu_mu_s_nu(glm::vec4 uvwz, float & r, float & mu, float & mu_s, float & nu, bool & ground) const {
+		float rho = H_ * unit_range_from_coord(uvwz.w, scattering_r);
+		r = std::sqrt(rho * rho + bottom_ * bottom_);
+
+		if(uvwz.z < 0.5f) {
+			float d_min = r - bottom_;
+			float d_max = rho;
+			float d = d_min + (d_max - d_min) * unit_range_from_coord(1.f - 2.f * uvwz.z, scattering_mu / 2);
+			mu = d == 0.f ? -1.f : clamp_cosine(-(rho * rho + d * d) / (2.f * r * d));
+			ground = true;
+		} else {
+			float d_min = p_.top_radius - r;
+			float d_max = rho + H_;
+			float d = d_min + (d_max - d_min) * unit_range_from_coord(2.f * uvwz.z - 1.f, scattering_mu / 2);
+			mu = d == 0.f ? 1.f : clamp_cosine((H_ * H_ - rho * rho - d * d) / (2.f * r * d));
+			ground = false;
+		}
+
+		float x_mu_s = unit_range_from_coord(uvwz.y, scattering_mu_s);
+		float d_min = p_.top_radius - bottom_;
+		float d_max = H_;
+		float A = (distance_to_top(bottom_, p_.mu_s_min) - d_min) / (d_max - d_min);
+		float a = (A - x_mu_s * A) / (1.f + x_mu_s * A);
+		float d = d_min + std::min(a, A) * (d_max - d_min);
+		mu_s = d == 0.f ? 1.f : clamp_cosine((H_ * H_ - d * d) / (2.f * d));
+
+		nu = clamp_cosine(uvwz.x * 2.f - 1.f);
+	}
+
+	// optical depth to the top of the atmosphere, trapezoidal rule
+	glm::vec3 optical_depth_to_top(float r, float mu) const {
+		float dx = distance_to_top(r, mu) / transmittance_samples;
+		glm::vec3 depth(0.f);
+		for(int i = 0; i <= transmittance_samples; i++) {
+			float d_i = i * dx;
+			float r_i = std::sqrt(d_i * d_i + 2.f * r * mu * d_i + r * r);
+			float weight = (i == 0 || i == transmittance_samples) ? 0.5f : 1.f;
+			depth += extinction_at(r_i) * (weight * dx);
+		}
+		return depth;
+	}
+
+	glm::vec3 compute_single_scattering(float r, float mu, float mu_s, float nu, bool ground, glm::vec3 & mie) const {
+		float dx = distance_to_boundary(r, mu, ground) / scattering_samples;
+		glm::vec3 rayleigh_sum(0.f), mie_sum(0.f), multiple_sum(0.f);
+		for(int i = 0; i <= scattering_samples; i++) {
+			float d_i = i * dx;
+			float r_d = clamp_radius(std::sqrt(d_i * d_i + 2.f * r * mu * d_i + r * r));
+			float mu_s_d = clamp_cosine((r * mu_s + d_i * nu) / r_d);
+			float weight = (i == 0 || i == scattering_samples) ? 0.5f : 1.f;
+
+			glm::vec3 t = transmittance(r, mu, d_i, ground) * weight;
+			glm::vec3 t_sun = t * transmittance_to_sun(r_d, mu_s_d);
+			rayleigh_sum += t_sun * rayleigh_density(r_d);
+			mie_sum += t_sun * mie_density(r_d);
+			// the multiple scattering transfer already includes the sun transmittance
+			multiple_sum += t * multiple_scattering(r_d, mu_s_d) * scattering_at(r_d);
+		}
+		mie = mie_sum * (p_.mie_scattering * dx);
+		return rayleigh_sum * p_.rayleigh_scattering * dx + multiple_sum * (dx / rayleigh_phase(nu));
+	}
+
+	// Hillaire 2020: second order scattering and the fraction f_ms transferred
+	// per order, for an isotropic phase function, summed as 1 / (1 - f_ms)
+	glm::vec3 compute_multiple_scattering(float r, float mu_s) const {
+		glm::vec3 sun(safe_sqrt(1.f - mu_s * mu_s), mu_s, 0.f);
+		glm::vec3 origin(0.f, r, 0.f);
+		float isotropic = 1.f / (4.f * glm::pi<float>());
+
+		glm::vec3 luminance(0.f), transfer(0.f);
+		int n = multiple_scattering_directions;
+		for(int k = 0; k < n; k++) {
+			// fibonacci sphere
+			float z = 1.f - (2.f * k + 1.f) / n;
+			float phi = k * 2.39996323f;
+			float s = safe_sqrt(1.f - z * z);
+			glm::vec3 direction(s * std::cos(phi), z, s * std::sin(phi));
+
+			float mu = direction.y;
+			bool ground = intersects_ground(r, mu);
+			float length = distance_to_boundary(r, mu, ground);
+			float dt = length / multiple_scattering_samples;
+
+			glm::vec3 throughput(1.f), l(0.f), f(0.f);
+			for(int i = 0; i < multiple_scattering_samples; i++) {
+				glm::vec3 x = origin + direction * ((i + 0.5f) * dt);
+				float r_x = clamp_radius(glm::length(x));
+				float mu_s_x = clamp_cosine(glm::dot(x, sun) / glm::length(x));
+
+				glm::vec3 sigma_s = scattering_at(r_x);
+				glm::vec3 sigma_t = extinction_at(r_x);
+				glm::vec3 step = exp(sigma_t * -dt);
+				// integral of the scattered light over the step, exact for a constant medium
+				glm::vec3 absorbed = divide(sigma_s - sigma_s * step, sigma_t);
+
+				l += throughput * absorbed * transmittance_to_sun(r_x, mu_s_x) * isotropic;
+				f += throughput * absorbed;
+				throughput = throughput * step;
+			}
+			if(ground) {
+				glm::vec3 x = origin + direction * length;
+				float mu_s_x = glm::dot(x, sun) / glm::length(x);
+				l += throughput * transmittance_to_sun(bottom_, mu_s_x) * p_.ground_albedo *
+				     (std::max(mu_s_x, 0.f) / glm::pi<float>());
+			}
+			luminance += l;
+			transfer += f * isotropic;
+		}
+		// uniform sphere samples, each covering 4 pi / n
+		luminance = luminance / float(n);
+		transfer = transfer * (4.f * glm::pi<float>() / n);
+		return divide(luminance, glm::vec3(1.f) - transfer);
+	}
+
+	void scattering_lerp(float r, float mu, float mu_s, float nu, bool ground, glm::vec4 & value) const {
+		glm::vec4 uvwz = scattering_uvwz(r, mu, mu_s, nu, ground);
+		float x = uvwz.x * (scattering_nu - 1);
+		float x0 = std::floor(x);
+		float lerp_nu = x - x0;
+		float z = std::clamp(uvwz.w * scattering_r - 0.5f, 0.f, scattering_r - 1.f);
+		int z0 = int(z);
+		int z1 = std::min(z0 + 1, scattering_r - 1);
+		float lerp_r = z - z0;
+
+		size_t layer = size_t(scattering_width) * scattering_height * 4;
+		auto fetch = [&](int z, float slice) {
+			std::vector<float> const & t = scattering_;
+			// each layer is its own table for the bilinear lookup
+			float u = (slice + uvwz.y) / scattering_nu;
+			float xs = std::clamp(u * scattering_width - 0.5f, 0.f, scattering_width - 1.f);
+			float ys = std::clamp(uvwz.z * scattering_height - 0.5f, 0.f, scattering_height - 1.f);
+			int xi = int(xs), yi = int(ys);
+			int xj = std::min(xi + 1, scattering_width - 1), yj = std::min(yi + 1, scattering_height - 1);
+			float fx = xs - xi, fy = ys - yi;
+			auto texel = [&](int tx, int ty) {
+				float const * p = &t[z * layer + 4 * (size_t(ty) * scattering_width + tx)];
+				return glm::vec4(p[0], p[1], p[2], p[3]);
+			};
+			glm::vec4 a = texel(xi, yi) * (1.f - fx) + texel(xj, yi) * fx;
+			glm::vec4 b = texel(xi, yj) * (1.f - fx) + texel(xj, yj) * fx;
+			return a * (1.f - fy) + b * fy;
+		};
+		auto at = [&](int z) { return fetch(z, x0) * (1.f - lerp_nu) + fetch(z, x0 + 1.f) * lerp_nu; };
+		value = at(z0) * (1.f - lerp_r) + at(z1) * lerp_r;
+	}
+
+	// phase weighted radiance from a combined scattering value, with single
+	// Mie scattering extrapolated from its red channel
+	glm::vec3 radiance(glm::vec4 s, float nu) const {
+		glm::vec3 combined = rgb(s);
+		glm::vec3 mie(0.f);
+		if(s.x > 0.f) {
+			mie = combined * (s.w / s.x) * (p_.rayleigh_scattering.x / p_.mie_scattering) *
+			      divide(glm::vec3(p_.mie_scattering), p_.rayleigh_scattering);
+		}
+		return combined * rayleigh_phase(nu) + mie * mie_phase(nu);
+	}
+
+public:
+	Atmosphere(AtmosphereParameters const & p)
+		: p_(p), bottom_(1.f), H_(std::sqrt(p.top_radius * p.top_radius - 1.f))
+	{ }
+	Atmosphere(Atmosphere const &) = delete;
+
+	AtmosphereParameters const & parameters() const { return p_; }
+
+	// the shader takes the parameters and table sizes as compile time constants
+	std::vector<std::pair<std::string, std::string>> defines() const {
+		auto f = [](float x) {
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%.9g", x);
+			std::string s = buf;
+			if(s.find_first_of(".e") == std::string::npos) s += ".";
+			return s;
+		};
+		return {
+			{ "ATMOSPHERE", "1" },
+			{ "ATMOSPHERE_TOP_RADIUS", f(p_.top_radius) },
+			{ "ATMOSPHERE_H", f(H_) },
+			{ "ATMOSPHERE_RAYLEIGH", "vec3(" + f(p_.rayleigh_scattering.x) + "," + f(p_.rayleigh_scattering.y) + "," + f(p_.rayleigh_scattering.z) + ")" },
+			{ "ATMOSPHERE_MIE_G", f(p_.mie_g) },
+			{ "ATMOSPHERE_MU_S_MIN", f(p_.mu_s_min) },
+			{ "ATMOSPHERE_SUN_ANGULAR_RADIUS", f(p_.sun_angular_radius) },
+			{ "ATMOSPHERE_TRANSMITTANCE_SIZE", "vec2(" + f(transmittance_width) + "," + f(transmittance_height) + ")" },
+			{ "ATMOSPHERE_SCATTERING_SIZE", "vec4(" + f(scattering_nu) + "," + f(scattering_mu_s) + "," + f(scattering_mu) + "," + f(scattering_r) + ")" },
+		};
+	}
+	bool ready() const { return !scattering_.empty(); }
+
+	float distance_to_top(float r, float mu) const {
+		return std::max(-r * mu + safe_sqrt(r * r * (mu * mu - 1.f) + p_.top_radius * p_.top_radius), 0.f);
+	}
+	float distance_to_bottom(float r, float mu) const {
+		return std::max(-r * mu - safe_sqrt(r * r * (mu * mu - 1.f) + bottom_ * bottom_), 0.f);
+	}
+	bool intersects_ground(float r, float mu) const {
+		return mu < 0.f && r * r * (mu * mu - 1.f) + bottom_ * bottom_ >= 0.f;
+	}
+	float distance_to_boundary(float r, float mu, bool ground) const {
+		return ground ? distance_to_bottom(r, mu) : distance_to_top(r, mu);
+	}
+
+	float rayleigh_phase(float nu) const {
+		return 3.f / (16.f * glm::pi<float>()) * (1.f + nu * nu);
+	}
+	float mie_phase(float nu) const {
+		float g = p_.mie_g;
+		float k = 3.f / (8.f * glm::pi<float>()) * (1.f - g * g) / (2.f + g * g);
+		return k * (1.f + nu * nu) / std::pow(1.f + g * g - 2.f * g * nu, 1.5f);
+	}
+
+	// table lookups, matching what the shader does
+
+	glm::vec3 transmittance(float r, float mu) const {
+		glm::vec2 uv = transmittance_uv(r, mu);
+		return rgb(sample(transmittance_, transmittance_width, transmittance_height, uv.x, uv.y));
+	}
+
+	// between the point at r, mu and the point `d` further along the ray
+	glm::vec3 transmittance(float r, float mu, float d, bool ground) const {
+		float r_d = clamp_radius(std::sqrt(d * d + 2.f * r * mu * d + r * r));
+		float mu_d = clamp_cosine((r * mu + d) / r_d);
+		if(ground) {
+			return min(divide(transmittance(r_d, -mu_d), transmittance(r, -mu)), glm::vec3(1.f));
+		}
+		return min(divide(transmittance(r, mu), transmittance(r_d, mu_d)), glm::vec3(1.f));
+	}
+
+	// with the sun disc fading out behind the horizon
+	glm::vec3 transmittance_to_sun(float r, float mu_s) const {
+		float sin_h = bottom_ / r;
+		float cos_h = -safe_sqrt(1.f - sin_h * sin_h);
+		float e = sin_h * p_.sun_angular_radius;
+		float x = std::clamp((mu_s - cos_h + e) / (2.f * e), 0.f, 1.f);
+		return transmittance(r, mu_s) * (x * x * (3.f - 2.f * x));
+	}
+
+	glm::vec3 multiple_scattering(float r, float mu_s) const {
+		float u = coord_from_unit_range((mu_s + 1.f) / 2.f, multiple_scattering_size);
+		float v = coord_from_unit_range((r - bottom_) / (p_.top_radius - bottom_), multiple_scattering_size);
+		return rgb(sample(multiple_scattering_, multiple_scattering_size, multiple_scattering_size, u, v));
+	}
+
+	// rayleigh and multiple scattering in rgb, single mie red in alpha, without phase
+	glm::vec4 scattering(float r, float mu, float mu_s, float nu, bool ground) const {
+		glm::vec4 value;
+		scattering_lerp(r, mu, mu_s, nu, ground, value);
+		return value;
+	}
+
+	// light scattered towards `camera` along `view`, and the transmittance of
+	// the rest of the ray.  positions are relative to the planet centre
+	glm::vec3 sky_radiance(glm::vec3 camera, glm::vec3 view, glm::vec3 sun, glm::vec3 & t) const {
+		float r = glm::length(camera);
+		float rmu = glm::dot(camera, view);
+		float to_top = -rmu - safe_sqrt(rmu * rmu - r * r + p_.top_radius * p_.top_radius);
+		if(to_top > 0.f) {
+			camera = camera + view * to_top;
+			r = p_.top_radius;
+			rmu += to_top;
+		} else if(r > p_.top_radius) {
+			t = glm::vec3(1.f);
+			return glm::vec3(0.f);
+		}
+
+		float mu = rmu / r;
+		float mu_s = glm::dot(camera, sun) / r;
+		float nu = glm::dot(view, sun);
+		bool ground = intersects_ground(r, mu);
+
+		t = ground ? glm::vec3(0.f) : transmittance(r, mu);
+		return radiance(scattering(r, mu, mu_s, nu, ground), nu);
+	}
+
+	// the same with the ground (or anything else) at `point`
+	glm::vec3 sky_radiance_to_point(glm::vec3 camera, glm::vec3 point, glm::vec3 sun, glm::vec3 & t) const {
+		glm::vec3 view = glm::normalize(point - camera);
+		float r = glm::length(camera);
+		float rmu = glm::dot(camera, view);
+		float to_top = -rmu - safe_sqrt(rmu * rmu - r * r + p_.top_radius * p_.top_radius);
+		if(to_top > 0.f) {
+			camera = camera + view * to_top;
+			r = p_.top_radius;
+			rmu += to_top;
+		}
+
+		float mu = rmu / r;
+		float mu_s = glm::dot(camera, sun) / r;
+		float nu = glm::dot(view, sun);
+		float d = glm::length(point - camera);
+		bool ground = intersects_ground(r, mu);
+
+		t = transmittance(r, mu, d, ground);
+
+		float r_p = clamp_radius(std::sqrt(d * d + 2.f * r * mu * d + r * r));
+		float mu_p = (r * mu + d) / r_p;
+		float mu_s_p = (r * mu_s + d * nu) / r_p;
+
+		glm::vec4 s = scattering(r, mu, mu_s, nu, ground);
+		glm::vec4 s_p = scattering(r_p, mu_p, mu_s_p, nu, ground);
+		glm::vec4 inscatter(s.x - t.x * s_p.x, s.y - t.y * s_p.y, s.z - t.z * s_p.z, s.w - t.x * s_p.w);
+		inscatter = glm::vec4(std::max(inscatter.x, 0.f), std::max(inscatter.y, 0.f),
+		                      std::max(inscatter.z, 0.f), std::max(inscatter.w, 0.f));
+		return radiance(inscatter, nu);
+	}
+
+	// brute force reference for sky_radiance: marches the view ray and the
+	// light path to the sun at every step instead of reading the tables.
+	// multiple scattering still comes from its transfer table
+	glm::vec3 marched_sky_radiance(glm::vec3 camera, glm::vec3 view, glm::vec3 sun, int steps, int sun_steps, glm::vec3 & t) const {
+		float r = glm::length(camera);
+		float rmu = glm::dot(camera, view);
+		float disc = rmu * rmu - r * r + p_.top_radius * p_.top_radius;
+		t = glm::vec3(1.f);
+		if(disc < 0.f) return glm::vec3(0.f);
+
+		float enter = std::max(-rmu - std::sqrt(disc), 0.f);
+		float exit = -rmu + std::sqrt(disc);
+		if(exit <= 0.f) return glm::vec3(0.f);
+
+		float ground_disc = rmu * rmu - r * r + 1.f;
+		if(ground_disc >= 0.f && -rmu - std::sqrt(ground_disc) > 0.f) exit = -rmu - std::sqrt(ground_disc);
+
+		float nu = glm::dot(view, sun);
+		float dt = (exit - enter) / steps;
+		glm::vec3 rayleigh(0.f), mie(0.f), multiple(0.f);
+		glm::vec3 depth(0.f);
+		for(int i = 0; i < steps; i++) {
+			glm::vec3 x = camera + view * (enter + (i + 0.5f) * dt);
+			float r_x = glm::length(x);
+			float mu_s_x = glm::dot(x, sun) / r_x;
+
+			glm::vec3 sigma_t = extinction_at(r_x);
+			glm::vec3 view_t = exp((depth + sigma_t * (0.5f * dt)) * -1.f);
+			depth += sigma_t * dt;
+
+			// exact light path, shadowed by the planet
+			glm::vec3 sun_t(0.f);
+			if(!intersects_ground(r_x, mu_s_x)) {
+				float ds = distance_to_top(r_x, mu_s_x) / sun_steps;
+				glm::vec3 sun_depth(0.f);
+				for(int j = 0; j < sun_steps; j++) {
+					glm::vec3 y = x + sun * ((j + 0.5f) * ds);
+					sun_depth += extinction_at(glm::length(y)) * ds;
+				}
+				sun_t = exp(sun_depth * -1.f);
+			}
+
+			rayleigh += view_t * sun_t * (rayleigh_density(r_x) * dt);
+			mie += view_t * sun_t * (mie_density(r_x) * dt);
+			multiple += view_t * multiple_scattering(clamp_radius(r_x), clamp_cosine(mu_s_x)) * scattering_at(r_x) * dt;
+		}
+		t = exp(depth * -1.f);
+		return rayleigh * p_.rayleigh_scattering * rayleigh_phase(nu) +
+		       mie * (p_.mie_scattering * mie_phase(nu)) + multiple;
+	}
+
+	// fills every table, each one in parallel over its rows
+	void precompute(ThreadPool & pool) {
+		transmittance_.assign(size_t(transmittance_width) * transmittance_height * 4, 0.f);
+		parallel_for(pool, transmittance_height, 1, [this](size_t begin, size_t end) {
+			for(size_t y = begin; y < end; y++) {
+				for(int x = 0; x < transmittance_width; x++) {
+					float r, mu;
+					transmittance_r_mu((x + 0.5f) / transmittance_width, (y + 0.5f) / transmittance_height, r, mu);
+					glm::vec3 t = exp(optical_depth_to_top(r, mu) * -1.f);
+					float * out = &transmittance_[4 * (y * transmittance_width + x)];
+					out[0] = t.x; out[1] = t.y; out[2] = t.z;
+				}
+			}
+		});
+
+		multiple_scattering_.assign(size_t(multiple_scattering_size) * multiple_scattering_size * 4, 0.f);
+		parallel_for(pool, multiple_scattering_size, 1, [this](size_t begin, size_t end) {
+			for(size_t y = begin; y < end; y++) {
+				for(int x = 0; x < multiple_scattering_size; x++) {
+					float mu_s = unit_range_from_coord((x + 0.5f) / multiple_scattering_size, multiple_scattering_size) * 2.f - 1.f;
+					float r = bottom_ + (p_.top_radius - bottom_) *
+					          unit_range_from_coord((y + 0.5f) / multiple_scattering_size, multiple_scattering_size);
+					glm::vec3 m = compute_multiple_scattering(clamp_radius(r), clamp_cosine(mu_s));
+					float * out = &multiple_scattering_[4 * (y * multiple_scattering_size + x)];
+					out[0] = m.x; out[1] = m.y; out[2] = m.z;
+				}
+			}
+		});
+
+		scattering_.assign(size_t(scattering_width) * scattering_height * scattering_r * 4, 0.f);
+		parallel_for(pool, size_t(scattering_r) * scattering_height, 1, [this](size_t begin, size_t end) {
+			for(size_t row = begin; row < end; row++) {
+				size_t z = row / scattering_height, y = row % scattering_height;
+				for(int x = 0; x < scattering_width; x++) {
+					float nu_index = std::floor(float(x) / scattering_mu_s);
+					float mu_s_index = x - nu_index * scattering_mu_s;
+					glm::vec4 uvwz(nu_index / (scattering_nu - 1), (mu_s_index + 0.5f) / scattering_mu_s,
+					               (y + 0.5f) / scattering_height, (z + 0.5f) / scattering_r);
+
+					float r, mu, mu_s, nu;
+					bool ground;
+					scattering_r_mu_mu_s_nu(uvwz, r, mu, mu_s, nu, ground);
+					// keep nu consistent with mu and mu_s
+					float spread = safe_sqrt((1.f - mu * mu) * (1.f - mu_s * mu_s));
+					nu = std::clamp(nu, mu * mu_s - spread, mu * mu_s + spread);
+
+					glm::vec3 mie;
+					glm::vec3 combined = compute_single_scattering(r, mu, mu_s, nu, ground, mie);
+					float * out = &scattering_[4 * ((z * scattering_height + y) * scattering_width + x)];
+					out[0] = combined.x; out[1] = combined.y; out[2] = combined.z; out[3] = mie.x;
+				}
+			}
+		});
+	}
+
+	// tables are cached under a name derived from the parameters
+	std::string cache_name() const {
+		char name[64];
+		snprintf(name, sizeof(name), "atmosphere_%016llx.bin", (unsigned long long)p_.hash());
+		return name;
+	}
+
+	bool load(std::string const & path) {
+		std::ifstream in(path, std::ios::in | std::ios::binary);
+		if(!in) return false;
+
+		cache_header header, expected = make_header();
+		in.read(reinterpret_cast<char *>(&header), sizeof(header));
+		if(!in || memcmp(&header, &expected, sizeof(header)) != 0) return false;
+
+		std::vector<float> t(size_t(transmittance_width) * transmittance_height * 4);
+		std::vector<float> m(size_t(multiple_scattering_size) * multiple_scattering_size * 4);
+		std::vector<float> s(size_t(scattering_width) * scattering_height * scattering_r * 4);
+		in.read(reinterpret_cast<char *>(t.data()), t.size() * sizeof(float));
+		in.read(reinterpret_cast<char *>(m.data()), m.size() * sizeof(float));
+		in.read(reinterpret_cast<char *>(s.data()), s.size() * sizeof(float));
+		if(!in) return false;
+
+		transmittance_.swap(t);
+		multiple_scattering_.swap(m);
+		scattering_.swap(s);
+		return true;
+	}
+
+	bool save(std::string const & path) const {
+		std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!out) return false;
+
+		cache_header header = make_header();
+		out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+		out.write(reinterpret_cast<char const *>(transmittance_.data()), transmittance_.size() * sizeof(float));
+		out.write(reinterpret_cast<char const *>(multiple_scattering_.data()), multiple_scattering_.size() * sizeof(float));
+		out.write(reinterpret_cast<char const *>(scattering_.data()), scattering_.size() * sizeof(float));
+		return bool(out);
+	}
+
+	float const * transmittance_data() const { return transmittance_.data(); }
+	float const * scattering_data() const { return scattering_.data(); }
+
+private:
+	cache_header make_header() const {
+		cache_header h;
+		memset(&h, 0, sizeof(h));
+		h.magic = cache_magic;
+		h.version = cache_version;
+		h.hash = p_.hash();
+		int32_t sizes[8] = { transmittance_width, transmittance_height, multiple_scattering_size,
+		                     scattering_r, scattering_mu, scattering_mu_s, scattering_nu, scattering_samples };
+		memcpy(h.sizes, sizes, sizeof(sizes));
+		return h;
+	}
+};
+
+#endif
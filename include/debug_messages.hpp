@@ -0,0 +1,246 @@
+#ifndef __DEBUG_MESSAGES_HPP__
+#define __DEBUG_MESSAGES_HPP__
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+
+// collects GL debug messages without doing any work in the driver's callback,
+// which runs on the render thread (or a driver thread) and may be called for
+// every draw by a chatty driver.  the callback copies the message into a
+// fixed lock-free ring and returns; a thread of its own drains the ring,
+// folds repeats of one source and id together and writes at most a few
+// lines per interval: the first occurrence of each message in full, then
+// how many more of it came since.  messages that find the ring full are
+// counted and dropped rather than waited for.
+class DebugMessageLog {
+public:
+	static constexpr size_t text_size = 240;
+
+private:
+	struct message {
+		std::atomic<uint64_t> sequence;
+		GLenum source, type, severity;
+		GLuint id;
+		uint32_t length;
+		char text[text_size];
+	};
+
+	struct summary {
+		GLenum type, severity;
+		std::string text;
+		uint64_t count;
+		uint64_t unreported;
+	};
+
+	std::unique_ptr<message[]> ring_;
+	size_t mask_;
+	std::atomic<uint64_t> head_;  // next slot a producer claims
+	uint64_t tail_;               // next slot the aggregator reads
+
+	std::atomic<uint64_t> received_;
+	std::atomic<uint64_t> dropped_;
+
+	// the aggregator's own
+	std::map<std::pair<GLenum,GLuint>, summary> seen_;
+	FILE * out_;
+	double interval_;
+	size_t lines_per_interval_;
+	uint64_t lines_;
+	uint64_t suppressed_;
+
+	std::atomic<bool> running_;
+	std::thread thread_;
+
+	static char const * source_name(GLenum source) {
+		switch(source) {
+		case GL_DEBUG_SOURCE_API: return "api";
+		case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+		case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+		case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+		case GL_DEBUG_SOURCE_APPLICATION: return "application";
+		default: return "other";
+		}
+	}
+
+	// moves what the producers finished into the summaries, in order.  a
+	// slot claimed but not yet written stops the drain until next time
+	size_t drain(std::vector<std::pair<GLenum,GLuint>> & fresh) {
+		size_t drained = 0;
+		for(;;) {
+			message & m = ring_[tail_ & mask_];
+			if(m.sequence.load(std::memory_order_acquire) != tail_ + 1) break;
+
+			auto key = std::make_pair(m.source, m.id);
+			auto it = seen_.find(key);
+			if(it == seen_.end()) {
+				seen_.emplace(key, summary{ m.type, m.severity, std::string(m.text, m.length), 1, 0 });
+				fresh.push_back(key);
+			} else {
+				it->second.count++;
+				it->second.unreported++;
+			}
+
+			// hands the slot back to the producers one lap on
+			m.sequence.store(tail_ + mask_ + 1, std::memory_order_release);
+			tail_++;
+			drained++;
+		}
+		return drained;
+	}
+
+	// one line, unless this interval has had its share.  `repeats` 0 for
+	// the first occurrence
+	bool line(GLenum source, GLuint id, summary const & s, uint64_t repeats) {
+		if(lines_ >= lines_per_interval_) {
+			suppressed_++;
+			return false;
+		}
+		char const * kind = s.type == GL_DEBUG_TYPE_ERROR ? "GL ERROR" : "GL";
+		if(repeats == 0) {
+			fprintf(out_, "%s %s %u, severity 0x%x: %s\n", kind, source_name(source), id, s.severity, s.text.c_str());
+		} else {
+			fprintf(out_, "%s %s %u, severity 0x%x, %llu more times: %s\n", kind, source_name(source), id,
+			        s.severity, (unsigned long long)repeats, s.text.c_str());
+		}
+		lines_++;
+		return true;
+	}
+
+	// new messages in full, then the counts of repeats since the last
+	// flush.  a new message held back is counted with the repeats
+	void flush(std::vector<std::pair<GLenum,GLuint>> & fresh) {
+		for(auto const & key : fresh) {
+			summary & s = seen_[key];
+			if(!line(key.first, key.second, s, 0)) s.unreported++;
+		}
+		fresh.clear();
+		for(auto & [key, s] : seen_) {
+			if(s.unreported == 0) continue;
+			if(line(key.first, key.second, s, s.unreported)) {
+				s.unreported = 0;
+			}
+		}
+		if(suppressed_ > 0) {
+			fprintf(out_, "GL debug: %llu more lines held back this interval\n", (unsigned long long)suppressed_);
+		}
+		fflush(out_);
+		lines_ = 0;
+		suppressed_ = 0;
+	}
+
+	void run() {
+		std::vector<std::pair<GLenum,GLuint>> fresh;
+		auto last_flush = std::chrono::steady_clock::now();
+		auto interval = std::chrono::duration<double>(interval_);
+		bool stopping = false;
+		while(!stopping) {
+			stopping = !running_.load(std::memory_order_acquire);
+			if(drain(fresh) == 0 && !stopping) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			}
+			auto now = std::chrono::steady_clock::now();
+			if(stopping || now - last_flush >= interval) {
+				flush(fresh);
+				last_flush = now;
+			}
+		}
+	}
+
+public:
+	// `capacity` messages in flight, rounded up to a power of two.  repeats
+	// are summarised every `interval` seconds, in at most `lines` lines
+	DebugMessageLog(size_t capacity = 1024, double interval = 1., size_t lines = 20, FILE * out = stderr)
+		: mask_(0), head_(0), tail_(0), received_(0), dropped_(0),
+		  out_(out), interval_(interval), lines_per_interval_(lines), lines_(0), suppressed_(0),
+		  running_(true)
+	{
+		size_t size = 1;
+		while(size < capacity) size *= 2;
+		ring_ = std::make_unique<message[]>(size);
+		mask_ = size - 1;
+		for(size_t i = 0; i < size; i++) {
+			ring_[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		thread_ = std::thread([this]() { run(); });
+	}
+	DebugMessageLog(DebugMessageLog const &) = delete;
+
+	~DebugMessageLog() {
+		stop();
+	}
+
+	// drains and flushes what is left; messages after this are counted as
+	// dropped.  remove the GL callback first for the counts to be final
+	void stop() {
+		if(!thread_.joinable()) return;
+		running_.store(false, std::memory_order_release);
+		thread_.join();
+		// claimed by producers that got in as the aggregator made its last pass
+		dropped_.fetch_add(head_.load(std::memory_order_acquire) - tail_, std::memory_order_relaxed);
+	}
+
+	// safe from any thread, never blocks
+	void push(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, GLchar const * text) {
+		received_.fetch_add(1, std::memory_order_relaxed);
+		if(!running_.load(std::memory_order_acquire)) {
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		uint64_t slot = head_.load(std::memory_order_relaxed);
+		message * m;
+		for(;;) {
+			m = &ring_[slot & mask_];
+			uint64_t sequence = m->sequence.load(std::memory_order_acquire);
+			if(sequence == slot) {
+				if(head_.compare_exchange_weak(slot, slot + 1, std::memory_order_relaxed)) break;
+			} else if(sequence < slot) {
+				// still holds a message from one lap back
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return;
+			} else {
+				slot = head_.load(std::memory_order_relaxed);
+			}
+		}
+
+		size_t n = length >= 0 ? std::min(size_t(length), text_size) : strnlen(text, text_size);
+		std::memcpy(m->text, text, n);
+		// the length given may count the terminating zero
+		while(n > 0 && m->text[n - 1] == '\0') n--;
+		m->source = source;
+		m->type = type;
+		m->id = id;
+		m->severity = severity;
+		m->length = uint32_t(n);
+		m->sequence.store(slot + 1, std::memory_order_release);
+	}
+
+	// for glDebugMessageCallback, with the log as the user parameter
+	static void GLAPIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity,
+	                                GLsizei length, GLchar const * text, void const * log)
+	{
+		const_cast<DebugMessageLog *>(static_cast<DebugMessageLog const *>(log))->push(source, type, id, severity, length, text);
+	}
+
+	uint64_t received() const { return received_.load(std::memory_order_relaxed); }
+	uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+	// distinct source and id pairs, once stopped
+	size_t distinct() const { return seen_.size(); }
+
+	void print_counters() const {
+		printf("GL debug messages %llu, dropped %llu with the ring full or the log stopped\n",
+		    (unsigned long long)received(), (unsigned long long)dropped());
+	}
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef __ECLIPSE_HPP__
+#define __ECLIPSE_HPP__
+
+#include <glm/vec3.hpp> // glm::vec3
+#include <glm/glm.hpp>  // glm::dot, glm::cross, glm::normalize
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// one body whose shadow can fall on another
+struct ShadowPair {
+    uint32_t occluder;
+    uint32_t receiver;
+};
+
+// finds the occluder/receiver pairs whose penumbra can reach each other, for
+// a directional sun of the given angular radius (radians).  bodies are
+// projected onto a plane across the sunlight and swept along one axis of it,
+// so the cost is n log n plus the candidates found instead of n^2, and only
+// real eclipses reach the shader.  returns the number of pairs tested exactly
+inline size_t find_shadow_pairs(glm::vec3 const * position, float const * radius, size_t count,
+                                glm::vec3 sun, float sun_angular_radius,
+                                std::vector<ShadowPair> & pairs)
+{
+    pairs.clear();
+    if(count < 2) return 0;
+
+    glm::vec3 l = glm::normalize(sun);
+    glm::vec3 helper = std::abs(l.y) < 0.9f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+    glm::vec3 e1 = glm::normalize(glm::cross(l, helper));
+    float spread = std::tan(sun_angular_radius);
+
+    // the penumbra widens by `spread` per unit of distance behind the
+    // occluder, which is at most the depth of the whole scene
+    float near = glm::dot(position[0], l), far = near;
+    float largest = 0.f;
+    for(size_t i = 0; i < count; i++) {
+        float s = glm::dot(position[i], l);
+        near = std::min(near, s);
+        far = std::max(far, s);
+        largest = std::max(largest, radius[i]);
+    }
+    float widening = (far - near + 2.f * largest) * spread;
+
+    struct interval {
+        float begin, end;
+        uint32_t body;
+    };
+    std::vector<interval> intervals(count);
+    for(size_t i = 0; i < count; i++) {
+        float u = glm::dot(position[i], e1);
+        float half = radius[i] + 0.5f * widening;
+        intervals[i] = { u - half, u + half, uint32_t(i) };
+    }
+    std::sort(intervals.begin(), intervals.end(), [](interval const & a, interval const & b) { return a.begin < b.begin; });
+
+    // exact test: the receiver reaches behind the occluder and into its penumbra cone
+    auto shadows = [&](uint32_t o, uint32_t r) {
+        glm::vec3 offset = position[r] - position[o];
+        float behind = -glm::dot(offset, l);
+        float depth = behind + radius[r];
+        if(depth <= 0.f) return false;
+
+        glm::vec3 across = offset + l * behind;
+        float reach = radius[o] + radius[r] + depth * spread;
+        return glm::dot(across, across) < reach * reach;
+    };
+
+    size_t tested = 0;
+    std::vector<interval> active;
+    for(auto const & next : intervals) {
+        active.erase(std::remove_if(active.begin(), active.end(),
+                     [&next](interval const & a) { return a.end < next.begin; }), active.end());
+        for(auto const & a : active) {
+            tested++;
+            if(shadows(a.body, next.body)) pairs.push_back({ a.body, next.body });
+            if(shadows(next.body, a.body)) pairs.push_back({ next.body, a.body });
+        }
+        active.push_back(next);
+    }
+    return tested;
+}
+
+#endif
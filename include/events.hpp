@@ -0,0 +1,276 @@
+#ifndef __EVENTS_HPP__
+#define __EVENTS_HPP__
+
+#include <glm/vec3.hpp> // glm::vec3, glm::dvec3
+#include <glm/glm.hpp>  // glm::dot, glm::cross, glm::length
+
+#include "scene.hpp"
+#include "thread_pool.hpp"
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// when one body passes in front of another as seen from a viewpoint
+// (transit), behind it (occultation), or into the penumbra it casts away from
+// the sun (eclipse).  each contact is a function of time that is negative
+// while the event lasts: the angle between the two discs less the sum of
+// their angular radii, or the distance from the shadow axis less the reach of
+// the penumbra.  those are sampled on a coarse grid, in blocks spread over a
+// thread pool, and every sign change is refined by bisection.  a grazing
+// event shorter than the grid shows up as a dip between samples, whose
+// minimum is found by golden section search before its roots are refined.
+
+enum class EventKind { transit, occultation, eclipse };
+
+inline char const * event_name(EventKind kind) {
+    switch(kind) {
+    case EventKind::transit: return "transit";
+    case EventKind::occultation: return "occultation";
+    default: return "eclipse";
+    }
+}
+
+// `body` transits, is occulted by or is eclipsed by `primary` from `start`
+// to `end` seconds.  events already under way at the start of the search, or
+// still going at its end, are cut off there
+struct Event {
+    EventKind kind;
+    uint32_t body;
+    uint32_t primary;
+    double start;
+    double end;
+};
+
+struct EventQuery {
+    double start;
+    double end;
+    // sampling interval, shorter than the shortest event that must not be
+    // missed.  grazing events down to a few times shorter are still found
+    double step;
+    // seconds to which event times are refined
+    double tolerance;
+    // (body, primary) to watch, each for all three kinds
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    // transits and occultations are seen from here, the scene's camera if empty
+    std::function<glm::dvec3(double)> viewpoint;
+    // unit direction towards the sun, the scene's own if empty
+    std::function<glm::dvec3(double)> sun;
+    // radians, widens the penumbra
+    double sun_angular_radius;
+    bool eclipses;
+    bool transits;  // and occultations
+
+    EventQuery()
+        : start(0.), end(0.), step(60.), tolerance(1e-3), sun_angular_radius(0.),
+          eclipses(true), transits(true)
+    { }
+};
+
+namespace detail {
+
+    inline glm::dvec3 body_position(Scene const & scene, uint32_t body, double t) {
+        glm::dvec3 position(0.);
+        for(int i = int(body); i >= 0; i = scene.bodies()[i].parent) {
+            position += glm::dvec3(scene.bodies()[i].orbit(t));
+        }
+        return position;
+    }
+
+    // the two contact functions of one pair
+    struct event_contacts {
+        Scene const & scene;
+        EventQuery const & query;
+        uint32_t body, primary;
+        double body_radius, primary_radius;
+        double spread;
+
+        event_contacts(Scene const & s, EventQuery const & q, uint32_t b, uint32_t p)
+            : scene(s), query(q), body(b), primary(p),
+              body_radius(s.bodies()[b].radius), primary_radius(s.bodies()[p].radius),
+              spread(std::tan(q.sun_angular_radius))
+        { }
+
+        glm::dvec3 viewpoint(double t) const {
+            if(query.viewpoint) return query.viewpoint(t);
+            return glm::dvec3(glm::inverse(scene.view_at(t)) * glm::vec4(0.f, 0.f, 0.f, 1.f));
+        }
+
+        glm::dvec3 sun(double t) const {
+            if(query.sun) return query.sun(t);
+            return glm::normalize(glm::dvec3(scene.sun_at(t)));
+        }
+
+        // angle between the discs less the sum of their angular radii
+        double discs(double t) const {
+            glm::dvec3 v = viewpoint(t);
+            glm::dvec3 a = body_position(scene, body, t) - v;
+            glm::dvec3 b = body_position(scene, primary, t) - v;
+            double da = glm::length(a), db = glm::length(b);
+            double separation = std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+            return separation - std::asin(std::min(body_radius / da, 1.)) - std::asin(std::min(primary_radius / db, 1.));
+        }
+
+        // distance of the body from the axis of the primary's shadow less the
+        // reach of the penumbra there, the same test find_shadow_pairs makes
+        double shadow(double t) const {
+            glm::dvec3 l = sun(t);
+            glm::dvec3 offset = body_position(scene, body, t) - body_position(scene, primary, t);
+            double behind = -glm::dot(offset, l);
+            double depth = behind + body_radius;
+            if(depth <= 0.) return body_radius + primary_radius - behind;
+            glm::dvec3 across = offset + l * behind;
+            return glm::length(across) - (primary_radius + body_radius + depth * spread);
+        }
+
+        double operator()(bool eclipse, double t) const {
+            return eclipse ? shadow(t) : discs(t);
+        }
+
+        bool in_front(double t) const {
+            glm::dvec3 v = viewpoint(t);
+            return glm::length(body_position(scene, body, t) - v) < glm::length(body_position(scene, primary, t) - v);
+        }
+    };
+
+    struct event_crossing {
+        double t;
+        bool entering;
+    };
+
+    template<typename F>
+    double refine_root(F const & f, double a, double fa, double b, double tolerance) {
+        while(b - a > tolerance) {
+            double m = 0.5 * (a + b);
+            double fm = f(m);
+            if((fm < 0.) == (fa < 0.)) {
+                a = m;
+                fa = fm;
+            } else {
+                b = m;
+            }
+        }
+        return 0.5 * (a + b);
+    }
+
+    // the lowest point of f on [a, b], which holds a single dip
+    template<typename F>
+    double refine_minimum(F const & f, double a, double b, double tolerance, double & fmin) {
+        const double g = 0.6180339887498949;
+        double c = b - g * (b - a), d = a + g * (b - a);
+        double fc = f(c), fd = f(d);
+        while(b - a > tolerance) {
+            if(fc < fd) {
+                b = d; d = c; fd = fc;
+                c = b - g * (b - a); fc = f(c);
+            } else {
+                a = c; c = d; fc = fd;
+                d = a + g * (b - a); fd = f(d);
+            }
+        }
+        double m = 0.5 * (a + b);
+        fmin = f(m);
+        return m;
+    }
+}
+
+// every event of the query's pairs between its start and end, ordered by
+// start time.  the samples are split into blocks run on `pool` and the
+// calling thread, which must not be one of the pool's workers, or on the
+// calling thread alone without one
+inline std::vector<Event> find_events(Scene const & scene, EventQuery const & query, ThreadPool * pool = nullptr) {
+    std::vector<Event> events;
+    if(query.end <= query.start || query.step <= 0.) return events;
+
+    size_t samples = size_t(std::ceil((query.end - query.start) / query.step)) + 1;
+    auto time_of = [&](size_t k) { return std::min(query.start + k * query.step, query.end); };
+
+    // each block samples its own stretch of time plus one sample either side,
+    // and owns the crossings that start inside it
+    const size_t block = 4096;
+    size_t blocks = (samples - 1 + block - 1) / block;
+
+    for(auto const & pair : query.pairs) {
+        detail::event_contacts contacts(scene, query, pair.first, pair.second);
+
+        for(bool eclipse : { false, true }) {
+            if(eclipse ? !query.eclipses : !query.transits) continue;
+            auto f = [&contacts, eclipse](double t) { return contacts(eclipse, t); };
+
+            std::vector<std::vector<detail::event_crossing>> found(blocks);
+            auto search = [&](size_t begin, size_t end) {
+                std::vector<double> values;
+                for(size_t b = begin; b < end; b++) {
+                    size_t first = b * block;
+                    size_t last = std::min(first + block, samples - 1);
+                    size_t lo = first > 0 ? first - 1 : first;
+                    size_t hi = std::min(last + 1, samples - 1);
+
+                    // the whole block first, in one pass over the grid
+                    values.resize(hi - lo + 1);
+                    for(size_t k = lo; k <= hi; k++) values[k - lo] = f(time_of(k));
+
+                    auto & crossings = found[b];
+                    for(size_t k = first; k < last; k++) {
+                        double t0 = time_of(k), t1 = time_of(k + 1);
+                        double f0 = values[k - lo], f1 = values[k + 1 - lo];
+                        if((f0 < 0.) != (f1 < 0.)) {
+                            crossings.push_back({ detail::refine_root(f, t0, f0, t1, query.tolerance), f1 < 0. });
+                            continue;
+                        }
+                        // a dip between samples that may reach below zero:
+                        // the sample at k is the lowest of its neighbours,
+                        // and the dip is searched on the side of the lower one
+                        if(f0 >= 0. && k > lo && k + 1 <= hi && values[k - 1 - lo] > f0 && f1 > f0) {
+                            double a = time_of(k - 1), c = t1;
+                            double fmin;
+                            double m = detail::refine_minimum(f, a, c, query.tolerance, fmin);
+                            if(fmin < 0.) {
+                                crossings.push_back({ detail::refine_root(f, a, f(a), m, query.tolerance), true });
+                                crossings.push_back({ detail::refine_root(f, m, fmin, c, query.tolerance), false });
+                            }
+                        }
+                    }
+                }
+            };
+            if(pool != nullptr) {
+                parallel_for(*pool, blocks, 1, search);
+            } else {
+                search(0, blocks);
+            }
+
+            // stitch the blocks' crossings into intervals
+            bool open = f(query.start) < 0.;
+            double opened = query.start;
+            auto close = [&](double t) {
+                Event e;
+                e.body = pair.first;
+                e.primary = pair.second;
+                e.start = opened;
+                e.end = t;
+                e.kind = eclipse ? EventKind::eclipse
+                                 : (contacts.in_front(0.5 * (opened + t)) ? EventKind::transit : EventKind::occultation);
+                events.push_back(e);
+            };
+            for(auto const & crossings : found) {
+                for(auto const & c : crossings) {
+                    if(c.entering && !open) {
+                        open = true;
+                        opened = c.t;
+                    } else if(!c.entering && open) {
+                        open = false;
+                        close(c.t);
+                    }
+                }
+            }
+            if(open) close(query.end);
+        }
+    }
+
+    std::sort(events.begin(), events.end(), [](Event const & a, Event const & b) { return a.start < b.start; });
+    return events;
+}
+
+#endif
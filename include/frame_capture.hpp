@@ -0,0 +1,179 @@
+#ifndef __FRAME_CAPTURE_HPP__
+#define __FRAME_CAPTURE_HPP__
+
+#include "gl.hpp"
+
+#include <deque>
+#include <cstdint>
+
+// offscreen color target
+class Framebuffer {
+private:
+	GLuint framebuffer_;
+	GLuint color_;
+	int width_;
+	int height_;
+
+public:
+	Framebuffer(int width, int height)
+		: framebuffer_(0), color_(0), width_(width), height_(height)
+	{
+		glGenRenderbuffers(1, &color_);
+		glBindRenderbuffer(GL_RENDERBUFFER, color_);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &framebuffer_);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_);
+
+		if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "framebuffer " << width_ << "x" << height_ << " is incomplete\n";
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	Framebuffer(Framebuffer const &) = delete;
+	~Framebuffer() {
+		glDeleteFramebuffers(1, &framebuffer_);
+		glDeleteRenderbuffers(1, &color_);
+	}
+
+	// binds for drawing and reading and covers the whole target with the viewport
+	void bind() const {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+		glViewport(0, 0, width_, height_);
+		GL_TRACE(viewport, GLint(0), GLint(0), GLsizei(width_), GLsizei(height_));
+	}
+	static void unbind() {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	int width() const { return width_; }
+	int height() const { return height_; }
+	operator GLuint() const { return framebuffer_; }
+};
+
+// asynchronous RGBA readback through a ring of pixel pack buffers.  read()
+// only queues the copy on the GPU; the pixels are handed out by collect() a
+// few frames later, once the fence behind them has signalled.
+class PixelReader {
+public:
+	// tag passed to read(), bottom-up RGBA rows, width, height
+	typedef function<void(uint64_t, unsigned char const *, int, int)> sink_type;
+
+private:
+	struct pending {
+		GLuint buffer;
+		GLsync fence;
+		uint64_t tag;
+	};
+
+	int width_;
+	int height_;
+	vector<GLuint> free_;
+	std::deque<pending> pending_;
+	vector<GLuint> buffers_;
+
+	static void wait(GLsync fence) {
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+		GL_TRACE(client_wait_sync, uint64_t(uintptr_t(fence)), GLbitfield(GL_SYNC_FLUSH_COMMANDS_BIT), GLuint64(GL_TIMEOUT_IGNORED));
+	}
+
+	void deliver(pending & p, sink_type const & sink) {
+		glDeleteSync(p.fence);
+		GL_TRACE(delete_sync, uint64_t(uintptr_t(p.fence)));
+
+		GLState & state = GLState::current();
+		state.bind_buffer(GL_PIXEL_PACK_BUFFER, p.buffer);
+		auto pixels = static_cast<unsigned char const *>(
+			glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size(), GL_MAP_READ_BIT));
+		GL_TRACE(map_buffer_range, GLenum(GL_PIXEL_PACK_BUFFER), uint64_t(0), uint64_t(size()), GLbitfield(GL_MAP_READ_BIT));
+		if(pixels != nullptr) {
+			sink(p.tag, pixels, width_, height_);
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		GL_TRACE(unmap_buffer, GLenum(GL_PIXEL_PACK_BUFFER));
+		state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		free_.push_back(p.buffer);
+	}
+
+public:
+	PixelReader(int width, int height, size_t depth = 3)
+		: width_(width), height_(height), buffers_(depth)
+	{
+		glGenBuffers(depth, buffers_.data());
+		GLState & state = GLState::current();
+		for(GLuint b : buffers_) {
+			GL_TRACE(gen_buffer, b);
+			state.bind_buffer(GL_PIXEL_PACK_BUFFER, b);
+			glBufferData(GL_PIXEL_PACK_BUFFER, size(), nullptr, GL_STREAM_READ);
+			GL_TRACE(buffer_data, GLenum(GL_PIXEL_PACK_BUFFER), GLenum(GL_STREAM_READ), trace_blob{ nullptr, uint32_t(size()) });
+		}
+		state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+		free_ = buffers_;
+	}
+	PixelReader(PixelReader const &) = delete;
+	~PixelReader() {
+		for(auto & p : pending_) glDeleteSync(p.fence);
+		glDeleteBuffers(buffers_.size(), buffers_.data());
+		for(GLuint b : buffers_) GLState::current().deleted_buffer(b);
+	}
+
+	size_t size() const { return size_t(width_) * height_ * 4; }
+	size_t in_flight() const { return pending_.size(); }
+
+	// queues a copy of the bound read framebuffer.  if every buffer is still
+	// in flight the oldest one is waited on and delivered to `sink` first
+	void read(uint64_t tag, sink_type const & sink) {
+		if(free_.empty()) {
+			pending p = pending_.front();
+			pending_.pop_front();
+			wait(p.fence);
+			deliver(p, sink);
+		}
+
+		GLuint buffer = free_.back();
+		free_.pop_back();
+
+		GLState & state = GLState::current();
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		GL_TRACE(pixel_store, GLenum(GL_PACK_ALIGNMENT), GLint(1));
+		state.bind_buffer(GL_PIXEL_PACK_BUFFER, buffer);
+		glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		GL_TRACE(read_pixels, GLint(0), GLint(0), GLsizei(width_), GLsizei(height_), GLenum(GL_RGBA), GLenum(GL_UNSIGNED_BYTE));
+		state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		GL_TRACE(fence_sync, uint64_t(uintptr_t(fence)));
+		pending_.push_back({ buffer, fence, tag });
+	}
+
+	// delivers, in order, every readback that has finished without blocking
+	size_t collect(sink_type const & sink) {
+		size_t delivered = 0;
+		while(!pending_.empty()) {
+			GLenum status = glClientWaitSync(pending_.front().fence, 0, 0);
+			GL_TRACE(client_wait_sync, uint64_t(uintptr_t(pending_.front().fence)), GLbitfield(0), GLuint64(0));
+			if(status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+
+			pending p = pending_.front();
+			pending_.pop_front();
+			deliver(p, sink);
+			delivered++;
+		}
+		return delivered;
+	}
+
+	// waits for and delivers everything still in flight
+	void flush(sink_type const & sink) {
+		while(!pending_.empty()) {
+			pending p = pending_.front();
+			pending_.pop_front();
+			wait(p.fence);
+			deliver(p, sink);
+		}
+	}
+};
+
+#endif
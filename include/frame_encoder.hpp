@@ -0,0 +1,189 @@
+#ifndef __FRAME_ENCODER_HPP__
+#define __FRAME_ENCODER_HPP__
+
+#include "thread_pool.hpp"
+
+#include <stb/stb_image_write.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+// compresses captured frames on a pool of worker threads.  submit() takes a
+// copy of the pixels and returns as soon as a slot is free, so the renderer
+// only waits when the encoders fall more than `max_queue` frames behind.
+class FrameEncoder {
+public:
+    enum format { png, yuv };
+
+private:
+    std::string directory_;
+    format format_;
+    size_t max_queue_;
+
+    std::mutex mutex_;
+    std::condition_variable slot_free_;
+    size_t in_flight_;
+
+    // raw yuv goes to a single stream, so frames that finish out of order
+    // wait here until the ones before them are written
+    std::ofstream stream_;
+    std::map<uint64_t, std::vector<unsigned char>> unwritten_;
+    uint64_t next_to_write_;
+
+    size_t submitted_;
+    size_t stalls_;
+    size_t depth_total_;
+    size_t depth_max_;
+    std::atomic<bool> failed_;
+
+    // last, so the workers are joined before the state they use goes away
+    ThreadPool pool_;
+
+    static void flip_rows(unsigned char * pixels, int width, int height, int channels) {
+        size_t stride = size_t(width) * channels;
+        std::vector<unsigned char> row(stride);
+        for(int y = 0; y < height / 2; y++) {
+            unsigned char * top = pixels + y * stride;
+            unsigned char * bottom = pixels + (height - 1 - y) * stride;
+            memcpy(row.data(), top, stride);
+            memcpy(top, bottom, stride);
+            memcpy(bottom, row.data(), stride);
+        }
+    }
+
+    // bottom-up RGBA to top-down planar I420 (BT.601, limited range)
+    static std::vector<unsigned char> rgba_to_i420(unsigned char const * rgba, int width, int height) {
+        int cw = (width + 1) / 2, ch = (height + 1) / 2;
+        std::vector<unsigned char> out(size_t(width) * height + 2 * size_t(cw) * ch);
+        unsigned char * Y = out.data();
+        unsigned char * U = Y + size_t(width) * height;
+        unsigned char * V = U + size_t(cw) * ch;
+
+        auto pixel = [&](int x, int y) {
+            return rgba + (size_t(height - 1 - y) * width + x) * 4;
+        };
+
+        for(int y = 0; y < height; y++) {
+            for(int x = 0; x < width; x++) {
+                unsigned char const * p = pixel(x, y);
+                Y[size_t(y) * width + x] = (unsigned char)(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+            }
+        }
+        for(int y = 0; y < ch; y++) {
+            for(int x = 0; x < cw; x++) {
+                // average the 2x2 block, clamped at odd edges
+                int r = 0, g = 0, b = 0;
+                for(int dy = 0; dy < 2; dy++) {
+                    for(int dx = 0; dx < 2; dx++) {
+                        unsigned char const * p = pixel(std::min(2 * x + dx, width - 1), std::min(2 * y + dy, height - 1));
+                        r += p[0]; g += p[1]; b += p[2];
+                    }
+                }
+                r /= 4; g /= 4; b /= 4;
+                U[size_t(y) * cw + x] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                V[size_t(y) * cw + x] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+        }
+        return out;
+    }
+
+    void encode(uint64_t frame, std::vector<unsigned char> & pixels, int width, int height) {
+        if(format_ == png) {
+            char name[32];
+            snprintf(name, sizeof(name), "/frame_%06llu.png", (unsigned long long)frame);
+
+            flip_rows(pixels.data(), width, height, 4);
+            if(!stbi_write_png((directory_ + name).c_str(), width, height, 4, pixels.data(), width * 4)) {
+                failed_ = true;
+            }
+            return;
+        }
+
+        auto converted = rgba_to_i420(pixels.data(), width, height);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        unwritten_.emplace(frame, std::move(converted));
+        for(auto it = unwritten_.find(next_to_write_); it != unwritten_.end(); it = unwritten_.find(next_to_write_)) {
+            stream_.write(reinterpret_cast<char const *>(it->second.data()), it->second.size());
+            unwritten_.erase(it);
+            next_to_write_++;
+        }
+        if(!stream_) failed_ = true;
+    }
+
+public:
+    FrameEncoder(std::string const & directory, format fmt, size_t threads, size_t max_queue, uint64_t first_frame = 0)
+        : directory_(directory), format_(fmt), max_queue_(std::max<size_t>(max_queue, 1)),
+          in_flight_(0), next_to_write_(first_frame),
+          submitted_(0), stalls_(0), depth_total_(0), depth_max_(0), failed_(false),
+          pool_(threads)
+    {
+        if(format_ == yuv) {
+            stream_.open(directory_ + "/frames.yuv", std::ios::out | std::ios::binary | std::ios::trunc);
+            failed_ = !stream_;
+        }
+    }
+    FrameEncoder(FrameEncoder const &) = delete;
+
+    ~FrameEncoder() { finish(); }
+
+    static bool parse_format(std::string const & name, format & fmt) {
+        if(name == "png") fmt = png;
+        else if(name == "yuv") fmt = yuv;
+        else return false;
+        return true;
+    }
+
+    // frames must be submitted with consecutive numbers starting at first_frame
+    void submit(uint64_t frame, unsigned char const * rgba, int width, int height) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if(in_flight_ >= max_queue_) {
+                stalls_++;
+                slot_free_.wait(lock, [this]() { return in_flight_ < max_queue_; });
+            }
+            in_flight_++;
+            submitted_++;
+            depth_total_ += in_flight_;
+            depth_max_ = std::max(depth_max_, in_flight_);
+        }
+
+        auto pixels = std::make_shared<std::vector<unsigned char>>(rgba, rgba + size_t(width) * height * 4);
+        pool_.submit([this, frame, pixels, width, height]() {
+            encode(frame, *pixels, width, height);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                in_flight_--;
+            }
+            slot_free_.notify_one();
+        });
+    }
+
+    // blocks until every submitted frame is on disk
+    void finish() {
+        pool_.wait();
+        if(stream_.is_open()) stream_.flush();
+    }
+
+    bool failed() const { return failed_; }
+    size_t submitted() const { return submitted_; }
+    size_t threads() const { return pool_.size(); }
+    // times submit() had to wait for an encoder
+    size_t stalls() const { return stalls_; }
+    size_t max_queue_depth() const { return depth_max_; }
+    double mean_queue_depth() const {
+        return submitted_ == 0 ? 0. : double(depth_total_) / submitted_;
+    }
+};
+
+#endif
@@ -16,6 +16,9 @@
 
 #include <stb/stb_image.h>
 #include <stb/stb_image_resize.h>
+#include "loader.hpp"
+#include "resample.hpp"
+#include "gl_state.hpp"
 #include <string>
 #include <tuple>
 #include <utility>
@@ -28,6 +31,7 @@
 #include <vector>
 #include <initializer_list>
 #include <algorithm>
+#include <cmath>
 #include <vector>
 #include <array>
 #include <sstream>
@@ -63,10 +67,62 @@ private:
 	int channels_;
 	unsigned char * data_;
 	GLuint texture_id;
+	int quality_;
+	size_t uploads_;
+
+	// where the loader's uploads land.  it follows the texture through a move
+	// and is cleared when the texture goes away, so an upload polled after
+	// either finds the right texture or none
+	struct upload_target { Texture * texture; };
+	std::shared_ptr<upload_target> target_;
+
+	// pixels decoded for an upload, freed with it unless the upload takes
+	// them, so a completion the loader drops unpolled does not leak them
+	struct decoded_image {
+		unsigned char * pixels = nullptr;
+		int width = 0, height = 0;
+		~decoded_image() { if(pixels != nullptr) stbi_image_free(pixels); }
+	};
+
+	void create() {
+		glGenTextures(1, &texture_id);
+		GL_TRACE(gen_texture, texture_id);
+		GLState::current().bind_texture(GL_TEXTURE_2D, texture_id);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		GL_TRACE(tex_parameter, GLenum(GL_TEXTURE_2D), GLenum(GL_TEXTURE_MIN_FILTER), GLint(GL_LINEAR));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		GL_TRACE(tex_parameter, GLenum(GL_TEXTURE_2D), GLenum(GL_TEXTURE_WRAP_S), GLint(GL_CLAMP_TO_EDGE));
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		GL_TRACE(tex_parameter, GLenum(GL_TEXTURE_2D), GLenum(GL_TEXTURE_WRAP_T), GLint(GL_CLAMP_TO_EDGE));
+	}
+
+	// replaces the contents of the texture if `quality` beats what is already there
+	void upload(unsigned char const * pixels, int width, int height, int quality) {
+		if(quality <= quality_) return;
+		quality_ = quality;
+		uploads_++;
+
+		GLState::current().bind_texture(GL_TEXTURE_2D, texture_id);
+		// TODO: only apply these packing rules when the width/height of the texture demand it
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		GL_TRACE(pixel_store, GLenum(GL_UNPACK_ALIGNMENT), GLint(1));
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+		GL_TRACE(pixel_store, GLenum(GL_UNPACK_ROW_LENGTH), GLint(0));
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+		GL_TRACE(pixel_store, GLenum(GL_UNPACK_SKIP_PIXELS), GLint(0));
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+		GL_TRACE(pixel_store, GLenum(GL_UNPACK_SKIP_ROWS), GLint(0));
+
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+		GL_TRACE(tex_image_2d, GLenum(GL_TEXTURE_2D), GLint(0), GLint(GL_RGB), width, height, GLenum(GL_RGB), GLenum(GL_UNSIGNED_BYTE),
+		         trace_blob{ pixels, uint32_t(width * height * 3) });
+	}
 
 public:
+	enum { placeholder_quality = 0, preview_quality = 1, full_quality = 2 };
+
 	Texture(string path, int desired_channels = 3) : 
-		path_(path), texture_id(0) 
+		path_(path), data_(nullptr), texture_id(0), quality_(-1), uploads_(0)
 	{
 		data_ = stbi_load(path_.c_str(), &width_, &height_, &channels_, desired_channels);
 
@@ -81,31 +137,75 @@ public:
         //     return;
         // }
 
-		glGenTextures(1, &texture_id);
-		glBindTexture(GL_TEXTURE_2D, texture_id);
-		// TODO: only apply these packing rules when the width/height of the texture demand it
-		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-		glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-		glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
-		glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+		create();
+		upload(data_, width_, height_, full_quality);
+	}
 
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width_, height_, 0, GL_RGB, GL_UNSIGNED_BYTE, data_);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glBindTexture(GL_TEXTURE_2D, 0);
+	// creates the texture immediately with a single grey texel and decodes the
+	// file on the loader's workers, swapping in a low resolution preview and
+	// then the full image as they become available
+	Texture(string path, AsyncLoader & loader) :
+		path_(path), data_(nullptr), texture_id(0), quality_(-1), uploads_(0)
+	{
+		if(!stbi_info(path_.c_str(), &width_, &height_, &channels_)) {
+            std::cerr << "could not open file: '" << path << "';\n";
+            return;
+		}
+
+		create();
+		unsigned char const grey[] = { 64, 64, 64 };
+		upload(grey, 1, 1, placeholder_quality);
+
+		// the decode steps only capture the path and the upload steps only the
+		// target, so the texture can be moved or destroyed on the GL thread with
+		// work still in flight
+		target_ = std::make_shared<upload_target>(upload_target{ this });
+		loader.submit([target = target_, path = path_]() -> function<void()> {
+			auto preview = std::make_shared<decoded_image>();
+			int c;
+			preview->pixels = load_preview_image(path, &preview->width, &preview->height, &c, 3);
+			if(preview->pixels == nullptr) return {};
+
+			return [target, preview]() {
+				if(target->texture == nullptr) return;
+				target->texture->upload(preview->pixels, preview->width, preview->height, preview_quality);
+			};
+		});
+		loader.submit([target = target_, path = path_]() -> function<void()> {
+			auto full = std::make_shared<decoded_image>();
+			int c;
+			full->pixels = stbi_load(path.c_str(), &full->width, &full->height, &c, 3);
+			if(full->pixels == nullptr) {
+				std::cerr << "could not decode file: '" << path << "';\n";
+				return {};
+			}
+
+			return [target, full]() {
+				Texture * texture = target->texture;
+				if(texture == nullptr) return;
+				if(texture->data_ != nullptr) stbi_image_free(texture->data_);
+				texture->data_ = std::exchange(full->pixels, nullptr);
+				texture->width_ = full->width;
+				texture->height_ = full->height;
+				texture->upload(texture->data_, texture->width_, texture->height_, full_quality);
+			};
+		});
 	}
 
 	Texture(Texture && rhs) 
 		: path_(rhs.path_), width_(rhs.width_), height_(rhs.height_), 
-		  channels_(rhs.channels_), data_(rhs.data_)
+		  channels_(rhs.channels_), data_(rhs.data_), texture_id(rhs.texture_id),
+		  quality_(rhs.quality_), uploads_(rhs.uploads_), target_(std::move(rhs.target_))
 	{
 		rhs.data_ = nullptr;
+		rhs.texture_id = 0;
+		if(target_) target_->texture = this;
 	}
 	Texture(Texture const & rhs) = delete;
 
 	~Texture() {
-		if(is_valid()) {
+		if(target_) target_->texture = nullptr;
+		if(data_ != nullptr) {
 			stbi_image_free(data_);
 			data_ = nullptr;
 		}
@@ -115,8 +215,11 @@ public:
         return (x != 0) && ((x & (x - 1)) == 0);
     }
 
-	bool is_valid() const { return data_ != nullptr; }
+	bool is_valid() const { return texture_id != 0; }
 	operator bool() const { return is_valid(); }
+	bool is_full_quality() const { return quality_ == full_quality; }
+	// changes whenever new pixels go in
+	size_t uploads() const { return uploads_; }
 	unsigned char * data() const { return data_; }
 	int width() const { return width_; } 
 	int height() const { return height_; }
@@ -131,79 +234,351 @@ class TextureArray {
     int width_;
     int height_;
     int channels_;
+    int quality_;
+    size_t uploads_;
+
+    // as Texture's, where the loader's uploads land
+    struct upload_target { TextureArray * array; };
+    std::shared_ptr<upload_target> target_;
+
+    // layers decoded for an upload, freed with it unless the upload takes
+    // them, so a completion the loader drops unpolled does not leak them
+    struct decoded_layers {
+        vector<unsigned char *> layers;
+        int width = 0, height = 0;
+        ~decoded_layers() { for(auto dat : layers) delete [] dat; }
+    };
+
+    void release() {
+        for(unsigned char *& dat : data_) {
+            delete [] dat;
+            dat = nullptr;
+        }
+        data_.clear();
+    }
 
-    void init() {
+public:
+    // loads every layer and resizes it to the largest width and the largest
+    // height among them, so equirectangular maps keep their 2:1 and layers
+    // already at that size are copied as they are.  runs without touching GL
+    // so it can be called from a worker thread
+    static bool decode(vector<string> const & paths, image_loader const & load, 
+                       vector<unsigned char *> & layers, int & width, int & height) 
+    {
         // load all the images
-        size_t count = paths_.size();
+        size_t count = paths.size();
 
         vector<int>             widths(count);
         vector<int>             heights(count);
         vector<int>             channels(count);
         vector<unsigned char *> temp(count);
 
+        bool loaded = true;
         for(int i = 0; i < count; i++) {
-            temp[i] = stbi_load(paths_[i].c_str(), &widths[i], &heights[i], &channels[i], 3);
+            temp[i] = load(paths[i], &widths[i], &heights[i], &channels[i], 3);
+            loaded = loaded && temp[i] != nullptr;
         }
 
-        auto max_width = *std::max_element(widths.begin(), widths.end());
-        auto max_height = *std::max_element(heights.begin(), heights.end());
-
-        // next power of 2
-        int siz = 1;
-        int levels = 0; // eventually set mipmap levels
-        for(; siz < max_width && siz < max_height; siz <<= 1, levels++) { }
+        if(loaded) {
+            width = *std::max_element(widths.begin(), widths.end());
+            height = *std::max_element(heights.begin(), heights.end());
 
+            layers.resize(count);
 
-
-        data_.resize(count);
+            for(int i = 0; i < count; i++) {
+                layers[i] = new unsigned char[size_t(width) * height * 3];
+                resample(temp[i], widths[i], heights[i], layers[i], width, height, 3,
+                         resample_default_filter(widths[i], heights[i], width, height), &resample_pool());
+            }
+        }
 
         for(int i = 0; i < count; i++) {
-            data_[i] = new unsigned char[max_width * max_height * 3];
-            stbir_resize_uint8(temp[i], widths[i], heights[i], 0, 
-                               data_[i], siz, siz, 0, 3);
+            if(temp[i] != nullptr) stbi_image_free(temp[i]);
+            temp[i] = nullptr;
         }
 
+        return loaded;
+    }
+
+private:
+    void create() {
         // LOG("glGenTextures")
         glGenTextures(1, &texture_id_);
+        GL_TRACE(gen_texture, texture_id_);
         // LOG("glBindTexure")
-        glBindTexture(GL_TEXTURE_2D_ARRAY, texture_id_);
-        // LOG("glTexStorage3D")
-        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGB8, siz, siz, count);
-        for(int i = 0; i < count; i++) {
-            // LOG("glTexSubImage3D")
-            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, siz, siz, 1, GL_RGB, GL_UNSIGNED_BYTE, data_[i]);
-        }
+        GLState::current().bind_texture(GL_TEXTURE_2D_ARRAY, texture_id_);
         glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        GL_TRACE(tex_parameter, GLenum(GL_TEXTURE_2D_ARRAY), GLenum(GL_TEXTURE_MIN_FILTER), GLint(GL_LINEAR));
         glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        GL_TRACE(tex_parameter, GLenum(GL_TEXTURE_2D_ARRAY), GLenum(GL_TEXTURE_MAG_FILTER), GLint(GL_LINEAR));
 		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		GL_TRACE(tex_parameter, GLenum(GL_TEXTURE_2D_ARRAY), GLenum(GL_TEXTURE_WRAP_S), GLint(GL_CLAMP_TO_EDGE));
 		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        
+		GL_TRACE(tex_parameter, GLenum(GL_TEXTURE_2D_ARRAY), GLenum(GL_TEXTURE_WRAP_T), GLint(GL_CLAMP_TO_EDGE));
+    }
 
+    // respecifies the storage of the array, so that later passes can replace
+    // the placeholder and preview levels under the same texture name
+    void upload(vector<unsigned char *> const & layers, int width, int height, int quality) {
+        if(quality <= quality_) return;
+        quality_ = quality;
+        uploads_++;
+        width_ = width;
+        height_ = height;
+
+        size_t count = layers.size();
+        GLState::current().bind_texture(GL_TEXTURE_2D_ARRAY, texture_id_);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        GL_TRACE(pixel_store, GLenum(GL_UNPACK_ALIGNMENT), GLint(1));
+        // LOG("glTexImage3D")
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8, width, height, count, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        GL_TRACE(tex_image_3d, GLenum(GL_TEXTURE_2D_ARRAY), GLint(0), GLint(GL_RGB8), width, height, GLsizei(count), 
+                 GLenum(GL_RGB), GLenum(GL_UNSIGNED_BYTE), trace_blob{ nullptr, 0 });
         for(int i = 0; i < count; i++) {
-            stbi_image_free(temp[i]);
-            temp[i] = nullptr;
+            // LOG("glTexSubImage3D")
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, width, height, 1, GL_RGB, GL_UNSIGNED_BYTE, layers[i]);
+            GL_TRACE(tex_sub_image_3d, GLenum(GL_TEXTURE_2D_ARRAY), GLint(0), GLint(0), GLint(0), GLint(i), width, height, GLsizei(1),
+                     GLenum(GL_RGB), GLenum(GL_UNSIGNED_BYTE), trace_blob{ layers[i], uint32_t(width * height * 3) });
         }
+    }
 
+    void init() {
+        int width, height;
+        create();
+        if(!decode(paths_, load_full_image, data_, width, height)) {
+            std::cerr << "could not load texture array\n";
+            release();
+            return;
+        }
+        upload(data_, width, height, Texture::full_quality);
+    }
+
+    void init(AsyncLoader & loader) {
+        create();
+
+        vector<unsigned char> grey(3 * paths_.size(), 64);
+        vector<unsigned char *> placeholder(paths_.size());
+        for(int i = 0; i < paths_.size(); i++) {
+            placeholder[i] = &grey[3 * i];
+        }
+        upload(placeholder, 1, 1, Texture::placeholder_quality);
+
+        // the upload steps only capture the target, as in Texture
+        target_ = std::make_shared<upload_target>(upload_target{ this });
+        loader.submit([target = target_, paths = paths_]() -> function<void()> {
+            auto decoded = std::make_shared<decoded_layers>();
+            if(!decode(paths, load_preview_image, decoded->layers, decoded->width, decoded->height)) return {};
+
+            return [target, decoded]() {
+                if(target->array == nullptr) return;
+                target->array->upload(decoded->layers, decoded->width, decoded->height, Texture::preview_quality);
+            };
+        });
+        loader.submit([target = target_, paths = paths_]() -> function<void()> {
+            auto decoded = std::make_shared<decoded_layers>();
+            if(!decode(paths, load_full_image, decoded->layers, decoded->width, decoded->height)) {
+                std::cerr << "could not load texture array\n";
+                return {};
+            }
+
+            return [target, decoded]() {
+                TextureArray * array = target->array;
+                if(array == nullptr) return;
+                array->release();
+                array->data_.swap(decoded->layers);
+                array->upload(array->data_, decoded->width, decoded->height, Texture::full_quality);
+            };
+        });
     }
 
 public:
     operator GLuint() const { return texture_id_; }
     TextureArray(vector<string> const & paths)
-        : paths_(paths)
+        : texture_id_(0), paths_(paths), width_(0), height_(0), channels_(3), quality_(-1), uploads_(0)
     { init(); }
 
     template<size_t LEN>
     TextureArray(std::array<string, LEN> const & paths)
-        : paths_(paths.begin(), paths.end())
+        : texture_id_(0), paths_(paths.begin(), paths.end()), width_(0), height_(0), channels_(3), quality_(-1), uploads_(0)
     { init(); }
 
+    TextureArray(vector<string> const & paths, AsyncLoader & loader)
+        : texture_id_(0), paths_(paths), width_(0), height_(0), channels_(3), quality_(-1), uploads_(0)
+    { init(loader); }
+
+    template<size_t LEN>
+    TextureArray(std::array<string, LEN> const & paths, AsyncLoader & loader)
+        : texture_id_(0), paths_(paths.begin(), paths.end()), width_(0), height_(0), channels_(3), quality_(-1), uploads_(0)
+    { init(loader); }
+
+    TextureArray(TextureArray && rhs)
+        : texture_id_(rhs.texture_id_), paths_(std::move(rhs.paths_)), data_(std::move(rhs.data_)),
+          width_(rhs.width_), height_(rhs.height_), channels_(rhs.channels_), quality_(rhs.quality_),
+          uploads_(rhs.uploads_), target_(std::move(rhs.target_))
+    {
+        rhs.data_.clear();
+        rhs.texture_id_ = 0;
+        if(target_) target_->array = this;
+    }
+    TextureArray(TextureArray const &) = delete;
+
+    bool is_full_quality() const { return quality_ == Texture::full_quality; }
+    size_t uploads() const { return uploads_; }
+    size_t layers() const { return paths_.size(); }
+
+    // average colour over the sphere of a layer in [0, 1], from a sparse grid
+    // of texels weighted by the area each row covers.  only known once the
+    // full quality layers are in, false until then
+    bool mean_color(size_t layer, glm::vec3 & color, int samples = 64) const {
+        if(!is_full_quality() || layer >= data_.size() || data_[layer] == nullptr) return false;
+
+        glm::vec3 sum(0.f);
+        float weights = 0.f;
+        for(int y = 0; y < samples; y++) {
+            float v = (y + 0.5f) / samples;
+            float weight = std::cos((v - 0.5f) * glm::pi<float>());
+            size_t row = size_t(v * height_);
+            for(int x = 0; x < samples; x++) {
+                size_t col = size_t((x + 0.5f) * width_ / samples);
+                unsigned char const * texel = data_[layer] + 3 * (row * width_ + col);
+                sum += weight * glm::vec3(texel[0], texel[1], texel[2]);
+            }
+            weights += weight * samples;
+        }
+        color = sum / (255.f * weights);
+        return true;
+    }
+    int width() const { return width_; }
+    int height() const { return height_; }
+
     ~TextureArray()
     {
-        for(unsigned char *& dat : data_) {
-            delete [] dat;
-            dat = nullptr;
+        if(target_) target_->array = nullptr;
+        release();
+    }
+};
+
+// a two layer RGB array for frames that change while it is drawn.  each new
+// frame goes into the layer the last draw did not sample, and `layer()` is
+// what the shader reads from, so an upload never waits on a draw in flight
+class SequenceTexture {
+    GLuint texture_id_;
+    int width_;
+    int height_;
+    float front_;
+    size_t uploads_;
+
+public:
+    SequenceTexture(int width, int height)
+        : texture_id_(0), width_(width), height_(height), front_(0.f), uploads_(0)
+    {
+        glGenTextures(1, &texture_id_);
+        GL_TRACE(gen_texture, texture_id_);
+        GLState::current().bind_texture(GL_TEXTURE_2D_ARRAY, texture_id_);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        GL_TRACE(tex_parameter, GLenum(GL_TEXTURE_2D_ARRAY), GLenum(GL_TEXTURE_MIN_FILTER), GLint(GL_LINEAR));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        GL_TRACE(tex_parameter, GLenum(GL_TEXTURE_2D_ARRAY), GLenum(GL_TEXTURE_MAG_FILTER), GLint(GL_LINEAR));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        GL_TRACE(tex_parameter, GLenum(GL_TEXTURE_2D_ARRAY), GLenum(GL_TEXTURE_WRAP_S), GLint(GL_CLAMP_TO_EDGE));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        GL_TRACE(tex_parameter, GLenum(GL_TEXTURE_2D_ARRAY), GLenum(GL_TEXTURE_WRAP_T), GLint(GL_CLAMP_TO_EDGE));
+
+        // grey until the first frame arrives
+        vector<unsigned char> grey(size_t(width_) * height_ * 3, 64);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        GL_TRACE(pixel_store, GLenum(GL_UNPACK_ALIGNMENT), GLint(1));
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB8, width_, height_, 2, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        GL_TRACE(tex_image_3d, GLenum(GL_TEXTURE_2D_ARRAY), GLint(0), GLint(GL_RGB8), width_, height_, GLsizei(2),
+                 GLenum(GL_RGB), GLenum(GL_UNSIGNED_BYTE), trace_blob{ nullptr, 0 });
+        upload(grey.data());
+    }
+    SequenceTexture(SequenceTexture const &) = delete;
+
+    ~SequenceTexture() {
+        if(texture_id_ != 0) {
+            glDeleteTextures(1, &texture_id_);
+            GLState::current().deleted_texture(texture_id_);
         }
     }
+
+    // `pixels` is width x height RGB
+    void upload(unsigned char const * pixels) {
+        GLint back = front_ == 0.f ? 1 : 0;
+        GLState::current().bind_texture(GL_TEXTURE_2D_ARRAY, texture_id_);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        GL_TRACE(pixel_store, GLenum(GL_UNPACK_ALIGNMENT), GLint(1));
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, back, width_, height_, 1, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+        GL_TRACE(tex_sub_image_3d, GLenum(GL_TEXTURE_2D_ARRAY), GLint(0), GLint(0), GLint(0), back, width_, height_, GLsizei(1),
+                 GLenum(GL_RGB), GLenum(GL_UNSIGNED_BYTE), trace_blob{ pixels, uint32_t(width_ * height_ * 3) });
+        front_ = float(back);
+        uploads_++;
+    }
+
+    operator GLuint() const { return texture_id_; }
+    // the layer holding the latest frame, for a float uniform
+    float const & layer() const { return front_; }
+    size_t uploads() const { return uploads_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+};
+
+// float RGBA table of precomputed data, a 2D texture when `layers` is 0 and
+// a 2D array otherwise.  stored at half precision and linearly filtered
+class LookupTable {
+private:
+	GLuint texture_id_;
+	GLenum target_;
+	int width_;
+	int height_;
+	int layers_;
+
+public:
+	LookupTable(float const * rgba, int width, int height, int layers = 0)
+		: texture_id_(0), target_(layers > 0 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D),
+		  width_(width), height_(height), layers_(layers)
+	{
+		glGenTextures(1, &texture_id_);
+		GL_TRACE(gen_texture, texture_id_);
+		GLState::current().bind_texture(target_, texture_id_);
+
+		GLenum const parameters[][2] = {
+			{ GL_TEXTURE_MIN_FILTER, GL_LINEAR },
+			{ GL_TEXTURE_MAG_FILTER, GL_LINEAR },
+			{ GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE },
+			{ GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE },
+		};
+		for(auto const & p : parameters) {
+			glTexParameteri(target_, p[0], p[1]);
+			GL_TRACE(tex_parameter, target_, p[0], GLint(p[1]));
+		}
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		GL_TRACE(pixel_store, GLenum(GL_UNPACK_ALIGNMENT), GLint(4));
+		uint32_t bytes = uint32_t(width) * height * std::max(layers, 1) * 4 * sizeof(float);
+		if(layers > 0) {
+			glTexImage3D(target_, 0, GL_RGBA16F, width, height, layers, 0, GL_RGBA, GL_FLOAT, rgba);
+			GL_TRACE(tex_image_3d, target_, GLint(0), GLint(GL_RGBA16F), width, height, GLsizei(layers),
+			         GLenum(GL_RGBA), GLenum(GL_FLOAT), trace_blob{ rgba, bytes });
+		} else {
+			glTexImage2D(target_, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, rgba);
+			GL_TRACE(tex_image_2d, target_, GLint(0), GLint(GL_RGBA16F), width, height,
+			         GLenum(GL_RGBA), GLenum(GL_FLOAT), trace_blob{ rgba, bytes });
+		}
+	}
+	LookupTable(LookupTable const &) = delete;
+	~LookupTable() {
+		if(texture_id_ != 0) {
+			glDeleteTextures(1, &texture_id_);
+			GLState::current().deleted_texture(texture_id_);
+		}
+	}
+
+	GLenum target() const { return target_; }
+	int width() const { return width_; }
+	int height() const { return height_; }
+	int layers() const { return layers_; }
+	operator GLuint() const { return texture_id_; }
 };
 
 class Shader {
@@ -264,6 +639,7 @@ private:
 		hdlr = glCreateShader(shader_type);
 		glShaderSource(hdlr, 3, sources, NULL);
 		glCompileShader(hdlr);
+		GL_TRACE(create_shader, hdlr, shader_type, trace_string(exts + defs + sh));
 		glGetShaderiv(hdlr, GL_COMPILE_STATUS, &status);
 		if(status != GL_TRUE) {
             GLint log_size;
@@ -338,19 +714,59 @@ class Program;
 class programParameters {
 private:
 	Program const & program_;
+	// uniform values, which stay with the program while others are in use
 	vector<function<void()>> param_setters_;
+	// textures, vertex buffers and per draw uniforms, context state that
+	// other programs' draws change, so set again before every draw
+	vector<function<void()>> draw_setters_;
+	// one per parameter that can change between draws, true if it has
+	// since the last time it was asked
+	vector<function<bool()>> change_probes_;
 	GLuint geometry_count_;
 	GLuint texture_count_;
 	vector<GLuint> texture_ids_;
+
+	GLint uniform_location(string const & name) const;
+	GLint attrib_location(string const & name) const;
+	GLuint texture_unit(GLint location);
 public:
 	programParameters(Program const & p);
 
 	template<typename T>
 	programParameters & operator()(string const & name, T const & dat);
+	// a uniform sent again on every draw, such as which view it is for
+	programParameters & per_draw(string const & name, float const & dat);
 
+	void draw_arrays(GLenum mode);
+	void draw_arrays(GLenum mode, GLsizei count);
 	void draw_arrays_triangle_fan();
+
+	// several draws from one upload of the uniforms, one per view: call
+	// set_uniforms() once, then redraw() for each
+	void set_uniforms();
+	void redraw(GLenum mode);
+	void redraw(GLenum mode, GLsizei count);
+
+	// whether a draw now would differ from one at the previous call: any
+	// uniform value, texture or streamed buffer changed in between
+	bool changed();
 };
 
+// true if `current` differs from `last`, which is then brought up to date
+template<typename T>
+bool changed_since(T & last, T const & current) {
+	if(last == current) return false;
+	last = current;
+	return true;
+}
+
+template<typename T>
+bool changed_since(vector<T> & last, T const * current, size_t count) {
+	if(last.size() == count && std::equal(last.begin(), last.end(), current)) return false;
+	last.assign(current, current + count);
+	return true;
+}
+
 
 class Program {
 private:
@@ -400,6 +816,7 @@ public:
 		glAttachShader(prog, vertex);
 		glAttachShader(prog, fragment);
 		glLinkProgram(prog);
+		GL_TRACE(create_program, prog, GLuint(vertex), GLuint(fragment));
 
 	    Program ret(prog, vertex, fragment);
 
@@ -418,27 +835,64 @@ public:
 programParameters::programParameters(Program const & p) : 
 	program_(p), geometry_count_(0), texture_count_(0) 
 { 
-	GLint maxTextureUnits;
+	GLint maxTextureUnits = 0;
 	glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &maxTextureUnits);
 	texture_ids_.resize(maxTextureUnits);
 	fill(texture_ids_.begin(), texture_ids_.end(), 0);
 }
 
+GLint programParameters::uniform_location(string const & name) const {
+	GLint location = glGetUniformLocation(program_, name.c_str());
+	GL_TRACE(uniform_location, GLuint(program_), location, trace_string(name));
+	return location;
+}
+
+// locations are not bounded by the number of texture units, a program with
+// many uniforms can put a sampler past the end
+GLuint programParameters::texture_unit(GLint location) {
+	GLuint texture_id = texture_count_++;
+	if(size_t(location) >= texture_ids_.size()) texture_ids_.resize(location + 1, 0);
+	texture_ids_[location] = texture_id;
+	return texture_id;
+}
+
+GLint programParameters::attrib_location(string const & name) const {
+	GLint location = glGetAttribLocation(program_, name.c_str());
+	GL_TRACE(attrib_location, GLuint(program_), location, trace_string(name));
+	return location;
+}
 
 template<>
 programParameters & programParameters::operator()(string const & name, TextureArray const & dat) {
-    GLint location = glGetUniformLocation(program_, name.c_str());
+	GLint location = uniform_location(name);
 	if(location < 0) return *this;
 
-	GLuint texture_id = texture_count_++;
-	texture_ids_[location] = texture_id;
+	GLuint texture_id = texture_unit(location);
 
-	param_setters_.push_back([&dat, location, texture_id]() { 
-		glActiveTexture(GL_TEXTURE0 + texture_id);
-        glBindTexture(GL_TEXTURE_2D_ARRAY, dat);
+	draw_setters_.push_back([&dat, location, texture_id]() { 
+		GLState & state = GLState::current();
+		state.bind_texture(texture_id, GL_TEXTURE_2D_ARRAY, dat);
         // glBindTextures(0, dat.size(), dat.textures());
-		glUniform1i(location, texture_id);
+		state.uniform1i(location, texture_id);
 	});
+	change_probes_.push_back([&dat, last = dat.uploads()]() mutable { return changed_since(last, dat.uploads()); });
+
+	return *this;
+}
+
+template<>
+programParameters & programParameters::operator()(string const & name, SequenceTexture const & dat) {
+	GLint location = uniform_location(name);
+	if(location < 0) return *this;
+
+	GLuint texture_id = texture_unit(location);
+
+	draw_setters_.push_back([&dat, location, texture_id]() {
+		GLState & state = GLState::current();
+		state.bind_texture(texture_id, GL_TEXTURE_2D_ARRAY, dat);
+		state.uniform1i(location, texture_id);
+	});
+	change_probes_.push_back([&dat, last = dat.uploads()]() mutable { return changed_since(last, dat.uploads()); });
 
 	return *this;
 }
@@ -447,12 +901,14 @@ programParameters & programParameters::operator()(string const & name, TextureAr
 template<>
 programParameters & programParameters::operator()(string const & name, float const & dat) 
 {
-    GLint location = glGetUniformLocation(program_, name.c_str());
+	GLint location = uniform_location(name);
     if(location < 0) return *this;
 
     param_setters_.push_back([&dat, location]() {
         glUniform1f(location, dat);
+        GL_TRACE(uniform1f, location, dat);
     });
+    change_probes_.push_back([&dat, last = dat]() mutable { return changed_since(last, dat); });
     return *this;
 }
 
@@ -460,28 +916,90 @@ programParameters & programParameters::operator()(string const & name, float con
 template<>
 programParameters & programParameters::operator()<>(string const & name, Texture const & dat) 
 {
-	GLint location = glGetUniformLocation(program_, name.c_str());
+	GLint location = uniform_location(name);
 	if(location < 0) return *this;
 
-	GLuint texture_id = texture_count_++;
-	texture_ids_[location] = texture_id;
+	GLuint texture_id = texture_unit(location);
 
-	param_setters_.push_back([&dat, location, texture_id]() { 
-		glActiveTexture(GL_TEXTURE0 + texture_id);
-		glBindTexture(GL_TEXTURE_2D, dat);
-		glUniform1i(location, texture_id);
+	draw_setters_.push_back([&dat, location, texture_id]() { 
+		GLState & state = GLState::current();
+		state.bind_texture(texture_id, GL_TEXTURE_2D, dat);
+		state.uniform1i(location, texture_id);
 	});
+	change_probes_.push_back([&dat, last = dat.uploads()]() mutable { return changed_since(last, dat.uploads()); });
 	return *this;
 }
 
+template<>
+programParameters & programParameters::operator()<>(string const & name, LookupTable const & dat) 
+{
+	GLint location = uniform_location(name);
+	if(location < 0) return *this;
+
+	GLuint texture_id = texture_unit(location);
+
+	draw_setters_.push_back([&dat, location, texture_id]() { 
+		GLState & state = GLState::current();
+		state.bind_texture(texture_id, dat.target(), dat);
+		state.uniform1i(location, texture_id);
+	});
+	return *this;
+}
+
+
+programParameters & programParameters::per_draw(string const & name, float const & dat)
+{
+	GLint location = uniform_location(name);
+	if(location < 0) return *this;
+
+	draw_setters_.push_back([&dat, location]() {
+		glUniform1f(location, dat);
+		GL_TRACE(uniform1f, location, dat);
+	});
+	return *this;
+}
+
+void programParameters::draw_arrays(GLenum mode) {
+	draw_arrays(mode, geometry_count_);
+}
+
+// for buffers whose length changes from frame to frame
+void programParameters::draw_arrays(GLenum mode, GLsizei count) {
+	set_uniforms();
+	redraw(mode, count);
+}
+
+void programParameters::set_uniforms() {
+	GLState::current().use_program(program_);
 
-void programParameters::draw_arrays_triangle_fan() {
-	glUseProgram(program_);
-    
 	for(auto const & p : param_setters_)
 		p();
+}
+
+void programParameters::redraw(GLenum mode) {
+	redraw(mode, geometry_count_);
+}
+
+void programParameters::redraw(GLenum mode, GLsizei count) {
+	GLState::current().use_program(program_);
+
+	for(auto const & p : draw_setters_)
+		p();
 
-	glDrawArrays(GL_TRIANGLE_FAN, 0, geometry_count_);
+	glDrawArrays(mode, 0, count);
+	GL_TRACE(draw_arrays, mode, GLint(0), count);
+}
+
+void programParameters::draw_arrays_triangle_fan() {
+	draw_arrays(GL_TRIANGLE_FAN);
+}
+
+bool programParameters::changed() {
+	// every probe runs, so each one's copy stays current
+	bool any = false;
+	for(auto & probe : change_probes_)
+		any = probe() || any;
+	return any;
 }
 
 std::ostream & operator<<(std::ostream & os, glm::mat4 const & mat) {
@@ -504,11 +1022,15 @@ private:
 public:
 	UniformMatrix(data_type const & data) : data_(data) {}
 
+	data_type const & value() const { return data_; }
+
 	void operator()(GLint location) {
 		glUniformMatrix4fv(location, 1, GL_FALSE, &data_[0][0]);
+		GL_TRACE(uniform_matrix4fv, location, GLsizei(1), trace_blob{ &data_[0][0], 16 * sizeof(float) });
 	}
 	void setup_parameter(GLint location) const {
 		glUniformMatrix4fv(location, 1, GL_FALSE, &data_[0][0]);
+		GL_TRACE(uniform_matrix4fv, location, GLsizei(1), trace_blob{ &data_[0][0], 16 * sizeof(float) });
 	}
 };
 
@@ -516,10 +1038,45 @@ public:
 template<>
 programParameters & programParameters::operator()<>(string const & name, UniformMatrix<float,4> const & dat) 
 {
-	GLint location = glGetUniformLocation(program_, name.c_str());
+	GLint location = uniform_location(name);
 	if(location < 0) return *this;
 
 	param_setters_.push_back(bind(&UniformMatrix<float,4>::setup_parameter, dat, location));
+	change_probes_.push_back([dat, last = dat.value()]() mutable { return changed_since(last, dat.value()); });
+	return *this;
+}
+
+template<typename T, size_t siz> class UniformMatrixArray;
+template<> class UniformMatrixArray<float,4> {
+	typedef glm::mat4 data_type;
+	friend class programParameters;
+private:
+	data_type const * data_;
+	size_t len_;
+public:
+	UniformMatrixArray(data_type const * data, size_t len)
+		: data_(data), len_(len)
+	{ }
+
+	data_type const * data() const { return data_; }
+	size_t size() const { return len_; }
+
+	void setup_parameter(GLint location) const {
+		glUniformMatrix4fv(location, len_, GL_FALSE, &data_[0][0][0]);
+		GL_TRACE(uniform_matrix4fv, location, GLsizei(len_), trace_blob{ &data_[0][0][0], uint32_t(16 * len_ * sizeof(float)) });
+	}
+};
+
+template<>
+programParameters & programParameters::operator()<>(string const & name, UniformMatrixArray<float,4> const & dat)
+{
+	GLint location = uniform_location(name);
+	if(location < 0) return *this;
+
+	param_setters_.push_back(bind(&UniformMatrixArray<float,4>::setup_parameter, &dat, location));
+	change_probes_.push_back([&dat, last = vector(dat.data(), dat.data() + dat.size())]() mutable {
+		return changed_since(last, dat.data(), dat.size());
+	});
 	return *this;
 }
 
@@ -532,21 +1089,26 @@ private:
 public:
 	Uniform(data_type const & data) : data_(data) {}
 
+	data_type const & value() const { return data_; }
+
 	void operator()(GLint location) {
 		glUniform3fv(location, 1, &data_[0]);
+		GL_TRACE(uniform3fv, location, GLsizei(1), trace_blob{ &data_[0], 3 * sizeof(float) });
 	}
 	void setup_parameter(GLint location) const {
 		glUniform3fv(location, 1, &data_[0]);
+		GL_TRACE(uniform3fv, location, GLsizei(1), trace_blob{ &data_[0], 3 * sizeof(float) });
 	}
 };
 
 template<>
 programParameters & programParameters::operator()<>(string const & name, Uniform<float,3> const & dat) 
 {
-	GLint location = glGetUniformLocation(program_, name.c_str());
+	GLint location = uniform_location(name);
 	if(location < 0) return *this;
 
 	param_setters_.push_back(bind(&Uniform<float,3>::setup_parameter, &dat, location));
+	change_probes_.push_back([&dat, last = dat.value()]() mutable { return changed_since(last, dat.value()); });
 	return *this;
 }
 
@@ -563,18 +1125,58 @@ public:
         : data_(data), len_(len)
     { }
 
+    data_type const * data() const { return data_; }
+    size_t size() const { return len_; }
+
     void setup_parameter(GLint location) const {
         glUniform3fv(location, len_, &(*data_)[0]);
+        GL_TRACE(uniform3fv, location, GLsizei(len_), trace_blob{ &(*data_)[0], uint32_t(3 * len_ * sizeof(float)) });
     }
 };
 
 template<>
 programParameters & programParameters::operator()<>(string const & name, UniformArray<float,3> const & dat) 
 {
-	GLint location = glGetUniformLocation(program_, name.c_str());
+	GLint location = uniform_location(name);
 	if(location < 0) return *this;
 
 	param_setters_.push_back(bind(&UniformArray<float,3>::setup_parameter, &dat, location));
+	change_probes_.push_back([&dat, last = vector(dat.data(), dat.data() + dat.size())]() mutable {
+		return changed_since(last, dat.data(), dat.size());
+	});
+	return *this;
+}
+
+template<> class UniformArray<float, 4> {
+    typedef glm::vec4 data_type;
+    friend class programParameters;
+private:
+    data_type const * data_;
+    size_t len_;
+public:
+    UniformArray(data_type const * data, size_t len) 
+        : data_(data), len_(len)
+    { }
+
+    data_type const * data() const { return data_; }
+    size_t size() const { return len_; }
+
+    void setup_parameter(GLint location) const {
+        glUniform4fv(location, len_, &(*data_)[0]);
+        GL_TRACE(uniform4fv, location, GLsizei(len_), trace_blob{ &(*data_)[0], uint32_t(4 * len_ * sizeof(float)) });
+    }
+};
+
+template<>
+programParameters & programParameters::operator()<>(string const & name, UniformArray<float,4> const & dat) 
+{
+	GLint location = uniform_location(name);
+	if(location < 0) return *this;
+
+	param_setters_.push_back(bind(&UniformArray<float,4>::setup_parameter, &dat, location));
+	change_probes_.push_back([&dat, last = vector(dat.data(), dat.data() + dat.size())]() mutable {
+		return changed_since(last, dat.data(), dat.size());
+	});
 	return *this;
 }
 
@@ -589,18 +1191,25 @@ public:
         : data_(data), len_(len)
     { }
 
+    data_type const * data() const { return data_; }
+    size_t size() const { return len_; }
+
     void setup_parameter(GLint location) const {
         glUniform1fv(location, len_, data_);
+        GL_TRACE(uniform1fv, location, GLsizei(len_), trace_blob{ data_, uint32_t(len_ * sizeof(float)) });
     }
 };
 
 template<>
 programParameters & programParameters::operator()<>(string const & name, UniformArray<float,1> const & dat) 
 {
-	GLint location = glGetUniformLocation(program_, name.c_str());
+	GLint location = uniform_location(name);
 	if(location < 0) return *this;
 
 	param_setters_.push_back(bind(&UniformArray<float,1>::setup_parameter, &dat, location));
+	change_probes_.push_back([&dat, last = vector(dat.data(), dat.data() + dat.size())]() mutable {
+		return changed_since(last, dat.data(), dat.size());
+	});
 	return *this;
 }
 
@@ -629,9 +1238,11 @@ public:
 		: count_(count), data_(first)
 	{
 		glGenBuffers(1, &buffer_);
-		glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+		GL_TRACE(gen_buffer, buffer_);
+		GLState::current().bind_buffer(GL_ARRAY_BUFFER, buffer_);
 		// ensure size parameter is bytes
 		glBufferData(GL_ARRAY_BUFFER, count_ * sizeof(T), static_cast<void const *>(data_), GL_STATIC_DRAW);
+		GL_TRACE(buffer_data, GLenum(GL_ARRAY_BUFFER), GLenum(GL_STATIC_DRAW), trace_blob{ data_, uint32_t(count_ * sizeof(T)) });
 	}
 	ArrayBuffer(ArrayBuffer && rhs) 
 		: buffer_(rhs.buffer_), count_(rhs.count_), data_(rhs.data_)
@@ -645,6 +1256,7 @@ public:
 		if(buffer_ == 0) return;
 
 		glDeleteBuffers(1, &buffer_);
+		GLState::current().deleted_buffer(buffer_);
 	}
 	size_t geometry_count() const {
 		return count_ / siz;
@@ -660,9 +1272,9 @@ public:
 	}
 
 	void setup_parameter(GLint location) const {
-		glBindBuffer(GL_ARRAY_BUFFER, buffer_);
-		glEnableVertexAttribArray(location);
-		glVertexAttribPointer(location, width, type(), GL_FALSE, 0, 0);
+		GLState & state = GLState::current();
+		state.enable_vertex_attrib_array(location);
+		state.vertex_attrib_pointer(location, buffer_, width, type(), GL_FALSE, 0, 0);
 	}
 };
 
@@ -670,11 +1282,125 @@ public:
 template<>
 programParameters & programParameters::operator()<>(string const & name, ArrayBuffer<float,2> const & dat) 
 {
-	GLint location = glGetAttribLocation(program_, name.c_str());
+	GLint location = attrib_location(name);
+	if(location < 0) return *this;
+
+	geometry_count_ = dat.geometry_count();
+	draw_setters_.push_back(bind(&ArrayBuffer<float,2>::setup_parameter, &dat, location));
+	return *this;
+}
+
+template<>
+programParameters & programParameters::operator()<>(string const & name, ArrayBuffer<float,1> const & dat) 
+{
+	GLint location = attrib_location(name);
+	if(location < 0) return *this;
+
+	geometry_count_ = dat.geometry_count();
+	draw_setters_.push_back(bind(&ArrayBuffer<float,1>::setup_parameter, &dat, location));
+	return *this;
+}
+
+// vertex data that changes every frame.  each update respecifies the whole
+// store, which orphans the old one: the driver hands out fresh memory
+// instead of waiting for draws that still read the previous frame
+template<typename T, size_t siz>
+class StreamBuffer {
+	GLuint buffer_;
+	size_t count_;
+	size_t updates_;
+public:
+	operator GLuint() const { return buffer_; }
+
+	typedef T value_type;
+	static constexpr size_t width = siz;
+
+	StreamBuffer(size_t count) 
+		: count_(count), updates_(0)
+	{
+		glGenBuffers(1, &buffer_);
+		GL_TRACE(gen_buffer, buffer_);
+		GLState::current().bind_buffer(GL_ARRAY_BUFFER, buffer_);
+		glBufferData(GL_ARRAY_BUFFER, size(), nullptr, GL_STREAM_DRAW);
+		GL_TRACE(buffer_data, GLenum(GL_ARRAY_BUFFER), GLenum(GL_STREAM_DRAW), trace_blob{ nullptr, size() });
+	}
+	StreamBuffer(StreamBuffer const & rhs) = delete;
+	~StreamBuffer() {
+		if(buffer_ == 0) return;
+
+		glDeleteBuffers(1, &buffer_);
+		GLState::current().deleted_buffer(buffer_);
+	}
+
+	// `data` holds count() * width values
+	void update(T const * data) {
+		GLState::current().bind_buffer(GL_ARRAY_BUFFER, buffer_);
+		glBufferData(GL_ARRAY_BUFFER, size(), data, GL_STREAM_DRAW);
+		GL_TRACE(buffer_data, GLenum(GL_ARRAY_BUFFER), GLenum(GL_STREAM_DRAW), trace_blob{ data, size() });
+		updates_++;
+	}
+	// changes the length as well
+	void update(T const * data, size_t count) {
+		count_ = count;
+		update(data);
+	}
+
+	size_t count() const {
+		return count_;
+	}
+	size_t updates() const {
+		return updates_;
+	}
+	size_t geometry_count() const {
+		return count_;
+	}
+	GLuint size() const {
+		return count_ * siz * sizeof(T);
+	}
+	GLenum type() const {
+		return gl_type<T>::value;
+	}
+
+	void setup_parameter(GLint location) const {
+		GLState & state = GLState::current();
+		state.enable_vertex_attrib_array(location);
+		state.vertex_attrib_pointer(location, buffer_, width, type(), GL_FALSE, 0, 0);
+	}
+};
+
+template<>
+programParameters & programParameters::operator()<>(string const & name, StreamBuffer<float,3> const & dat) 
+{
+	GLint location = attrib_location(name);
+	if(location < 0) return *this;
+
+	geometry_count_ = dat.geometry_count();
+	draw_setters_.push_back(bind(&StreamBuffer<float,3>::setup_parameter, &dat, location));
+	change_probes_.push_back([&dat, last = dat.updates()]() mutable { return changed_since(last, dat.updates()); });
+	return *this;
+}
+
+template<>
+programParameters & programParameters::operator()<>(string const & name, StreamBuffer<float,4> const & dat) 
+{
+	GLint location = attrib_location(name);
+	if(location < 0) return *this;
+
+	geometry_count_ = dat.geometry_count();
+	draw_setters_.push_back(bind(&StreamBuffer<float,4>::setup_parameter, &dat, location));
+	change_probes_.push_back([&dat, last = dat.updates()]() mutable { return changed_since(last, dat.updates()); });
+	return *this;
+}
+
+template<>
+programParameters & programParameters::operator()<>(string const & name, StreamBuffer<float,1> const & dat) 
+{
+	GLint location = attrib_location(name);
 	if(location < 0) return *this;
 
 	geometry_count_ = dat.geometry_count();
-	param_setters_.push_back(bind(&ArrayBuffer<float,2>::setup_parameter, &dat, location));
+	draw_setters_.push_back(bind(&StreamBuffer<float,1>::setup_parameter, &dat, location));
+	change_probes_.push_back([&dat, last = dat.updates()]() mutable { return changed_since(last, dat.updates()); });
 	return *this;
 }
 
@@ -0,0 +1,255 @@
+#ifndef __GL_STATE_HPP__
+#define __GL_STATE_HPP__
+
+#include <GL/glew.h>
+
+#include "gl_trace.hpp"
+
+#include <vector>
+#include <array>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <cstdio>
+
+// shadows the GL binding state touched by the wrappers in gl.hpp so calls
+// that would not change anything are never issued.  everything in gl.hpp
+// binds through here; code that binds behind its back must call
+// invalidate() afterwards.  assumes a single context.
+class GLState {
+public:
+	enum category { program, texture_unit, texture, buffer, attrib, uniform, category_count };
+
+private:
+	static constexpr GLuint unknown = ~0u;
+	static constexpr size_t texture_targets = 4;
+
+	struct attrib_pointer {
+		GLuint buffer;
+		GLint size;
+		GLenum type;
+		GLboolean normalized;
+		GLsizei stride;
+		void const * offset;
+
+		bool operator==(attrib_pointer const & rhs) const {
+			return buffer == rhs.buffer && size == rhs.size && type == rhs.type &&
+			       normalized == rhs.normalized && stride == rhs.stride && offset == rhs.offset;
+		}
+	};
+
+	bool enabled_;
+	GLuint program_;
+	GLuint active_unit_;
+	std::vector<std::array<GLuint, texture_targets>> textures_;
+	std::map<GLenum, GLuint> buffers_;
+	std::vector<int> attrib_enabled_; // -1 unknown
+	std::vector<attrib_pointer> attrib_pointers_;
+	std::vector<bool> attrib_pointer_known_;
+	std::map<std::pair<GLuint, GLint>, GLint> uniform_ints_;
+
+	size_t issued_[category_count];
+	size_t skipped_[category_count];
+
+	static size_t target_index(GLenum target) {
+		switch(target) {
+		case GL_TEXTURE_2D: return 0;
+		case GL_TEXTURE_2D_ARRAY: return 1;
+		case GL_TEXTURE_3D: return 2;
+		default: return 3;
+		}
+	}
+
+	// true if the call has to be made.  records the new value either way
+	template<typename T>
+	bool changes(T & shadow, T const & value, category c) {
+		if(enabled_ && shadow == value) {
+			skipped_[c]++;
+			return false;
+		}
+		shadow = value;
+		issued_[c]++;
+		return true;
+	}
+
+	void attrib_slot(GLuint index) {
+		if(index >= attrib_enabled_.size()) {
+			attrib_enabled_.resize(index + 1, -1);
+			attrib_pointers_.resize(index + 1);
+			attrib_pointer_known_.resize(index + 1, false);
+		}
+	}
+
+	GLState() : enabled_(true) {
+		invalidate();
+		reset_counters();
+	}
+
+public:
+	static GLState & current() {
+		static GLState state;
+		return state;
+	}
+
+	// with the cache disabled every call is issued, for comparisons
+	void set_enabled(bool enabled) { enabled_ = enabled; }
+	bool enabled() const { return enabled_; }
+
+	// forget everything, the next call of each kind will be issued
+	void invalidate() {
+		program_ = unknown;
+		active_unit_ = unknown;
+		for(auto & unit : textures_) unit.fill(unknown);
+		buffers_.clear();
+		std::fill(attrib_enabled_.begin(), attrib_enabled_.end(), -1);
+		std::fill(attrib_pointer_known_.begin(), attrib_pointer_known_.end(), false);
+		uniform_ints_.clear();
+	}
+
+	void use_program(GLuint program) {
+		if(changes(program_, program, GLState::program)) {
+			glUseProgram(program);
+			GL_TRACE(use_program, program);
+		}
+	}
+	GLuint current_program() const { return program_; }
+
+	void active_texture(GLuint unit) {
+		if(changes(active_unit_, unit, texture_unit)) {
+			glActiveTexture(GL_TEXTURE0 + unit);
+			GL_TRACE(active_texture, unit);
+		}
+	}
+
+	// binds to whichever unit is active
+	void bind_texture(GLenum target, GLuint texture_id) {
+		if(active_unit_ == unknown) active_texture(0);
+		if(active_unit_ >= textures_.size()) {
+			std::array<GLuint, texture_targets> unit;
+			unit.fill(unknown);
+			textures_.resize(active_unit_ + 1, unit);
+		}
+
+		if(changes(textures_[active_unit_][target_index(target)], texture_id, texture)) {
+			glBindTexture(target, texture_id);
+			GL_TRACE(bind_texture, target, texture_id);
+		}
+	}
+
+	// only switches the active unit when the binding on `unit` has to change
+	void bind_texture(GLuint unit, GLenum target, GLuint texture_id) {
+		if(enabled_ && unit < textures_.size() && textures_[unit][target_index(target)] == texture_id) {
+			skipped_[texture]++;
+			return;
+		}
+		active_texture(unit);
+		bind_texture(target, texture_id);
+	}
+
+	void bind_buffer(GLenum target, GLuint buffer_id) {
+		auto it = buffers_.find(target);
+		if(it == buffers_.end()) it = buffers_.emplace(target, unknown).first;
+
+		if(changes(it->second, buffer_id, buffer)) {
+			glBindBuffer(target, buffer_id);
+			GL_TRACE(bind_buffer, target, buffer_id);
+		}
+	}
+
+	void enable_vertex_attrib_array(GLuint index) {
+		attrib_slot(index);
+		if(changes(attrib_enabled_[index], 1, attrib)) {
+			glEnableVertexAttribArray(index);
+			GL_TRACE(enable_attrib, index);
+		}
+	}
+	void disable_vertex_attrib_array(GLuint index) {
+		attrib_slot(index);
+		if(changes(attrib_enabled_[index], 0, attrib)) {
+			glDisableVertexAttribArray(index);
+			GL_TRACE(disable_attrib, index);
+		}
+	}
+
+	// binds `buffer_id` to GL_ARRAY_BUFFER only if the pointer has to be respecified
+	void vertex_attrib_pointer(GLuint index, GLuint buffer_id, GLint size, GLenum type,
+	                           GLboolean normalized, GLsizei stride, void const * offset)
+	{
+		attrib_slot(index);
+		attrib_pointer p = { buffer_id, size, type, normalized, stride, offset };
+		if(enabled_ && attrib_pointer_known_[index] && attrib_pointers_[index] == p) {
+			skipped_[attrib]++;
+			return;
+		}
+
+		bind_buffer(GL_ARRAY_BUFFER, buffer_id);
+		glVertexAttribPointer(index, size, type, normalized, stride, offset);
+		GL_TRACE(attrib_pointer, index, size, type, normalized, stride, uint64_t(reinterpret_cast<uintptr_t>(offset)));
+		attrib_pointers_[index] = p;
+		attrib_pointer_known_[index] = true;
+		issued_[attrib]++;
+	}
+
+	// integer uniforms on the current program, i.e. sampler units
+	void uniform1i(GLint location, GLint value) {
+		auto key = std::make_pair(program_, location);
+		auto it = uniform_ints_.find(key);
+		if(enabled_ && it != uniform_ints_.end() && it->second == value) {
+			skipped_[uniform]++;
+			return;
+		}
+
+		glUniform1i(location, value);
+		GL_TRACE(uniform1i, location, value);
+		uniform_ints_[key] = value;
+		issued_[uniform]++;
+	}
+
+	// the names may be reused, so drop anything bound to them
+	void deleted_texture(GLuint texture_id) {
+		for(auto & unit : textures_) {
+			for(auto & t : unit) if(t == texture_id) t = unknown;
+		}
+	}
+	void deleted_buffer(GLuint buffer_id) {
+		for(auto & b : buffers_) if(b.second == buffer_id) b.second = unknown;
+		for(size_t i = 0; i < attrib_pointers_.size(); i++) {
+			if(attrib_pointers_[i].buffer == buffer_id) attrib_pointer_known_[i] = false;
+		}
+	}
+	void deleted_program(GLuint program_id) {
+		if(program_ == program_id) program_ = unknown;
+		for(auto it = uniform_ints_.begin(); it != uniform_ints_.end();) {
+			if(it->first.first == program_id) it = uniform_ints_.erase(it);
+			else ++it;
+		}
+	}
+
+	void reset_counters() {
+		std::fill(issued_, issued_ + category_count, 0);
+		std::fill(skipped_, skipped_ + category_count, 0);
+	}
+	size_t issued(category c) const { return issued_[c]; }
+	size_t skipped(category c) const { return skipped_[c]; }
+	size_t issued() const {
+		size_t total = 0;
+		for(size_t c = 0; c < category_count; c++) total += issued_[c];
+		return total;
+	}
+	size_t skipped() const {
+		size_t total = 0;
+		for(size_t c = 0; c < category_count; c++) total += skipped_[c];
+		return total;
+	}
+
+	void print_counters(FILE * out = stdout) const {
+		static char const * names[] = { "program", "active texture", "bind texture", "bind buffer", "vertex attrib", "sampler uniform" };
+		fprintf(out, "gl state cache %s: %zu calls issued, %zu skipped\n",
+		        enabled_ ? "on" : "off", issued(), skipped());
+		for(size_t c = 0; c < category_count; c++) {
+			fprintf(out, "\t%-16s %10zu issued %10zu skipped\n", names[c], issued_[c], skipped_[c]);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,233 @@
+#ifndef __GL_TRACE_HPP__
+#define __GL_TRACE_HPP__
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// binary trace of the GL calls made through the wrappers in gl.hpp, for
+// gl_planets_replay.  the file starts with a trace_header followed by records
+// of [op][payload size][payload].  payload fields are written in call order;
+// variable length data (pixels, shader source, uniform values) is a u32 size
+// followed by the bytes.  GL names and uniform locations are the ones seen
+// while recording, the replayer maps them to its own; sync objects are
+// recorded by their pointer value.
+
+static const uint32_t trace_magic = 0x54504c47; // "GLPT"
+static const uint32_t trace_version = 1;
+
+struct trace_header {
+	uint32_t magic;
+	uint32_t version;
+};
+
+enum class TraceOp : uint32_t {
+	gen_texture = 1,    // name
+	gen_buffer,         // name
+	create_shader,      // name, type, source
+	create_program,     // name, vertex shader, fragment shader
+	uniform_location,   // program, location, uniform name
+	attrib_location,    // program, location, attribute name
+	use_program,        // program
+	active_texture,     // unit
+	bind_texture,       // target, name
+	bind_buffer,        // target, name
+	enable_attrib,      // index
+	disable_attrib,     // index
+	attrib_pointer,     // index, size, type, normalized, stride, offset
+	pixel_store,        // pname, param
+	tex_parameter,      // target, pname, param
+	tex_image_2d,       // target, level, internal format, width, height, format, type, pixels
+	tex_image_3d,       // target, level, internal format, width, height, depth, format, type, pixels
+	tex_sub_image_3d,   // target, level, x, y, z, width, height, depth, format, type, pixels
+	buffer_data,        // target, usage, data
+	buffer_sub_data,    // target, offset, data
+	uniform1i,          // location, value
+	uniform1f,          // location, value
+	uniform1fv,         // location, count, values
+	uniform3fv,         // location, count, values
+	uniform4fv,         // location, count, values
+	uniform_matrix4fv,  // location, count, values
+	clear,              // mask
+	enable,             // capability
+	cull_face,          // mode
+	viewport,           // x, y, width, height
+	draw_arrays,        // mode, first, count
+	frame_end,          //
+	disable,            // capability
+	blend_func,         // source factor, destination factor
+	read_pixels,        // x, y, width, height, format, type, into the bound pack buffer
+	fence_sync,         // sync
+	client_wait_sync,   // sync, flags, timeout
+	delete_sync,        // sync
+	map_buffer_range,   // target, offset, length, access
+	unmap_buffer,       // target
+	op_count
+};
+
+// variable length field
+struct trace_blob {
+	void const * data;
+	uint32_t size;
+};
+
+inline trace_blob trace_string(std::string const & s) {
+	return { s.data(), uint32_t(s.size()) };
+}
+
+class GLTrace {
+private:
+	std::ofstream out_;
+	std::vector<char> record_;
+	size_t frames_;
+	size_t frame_limit_;
+	size_t bytes_;
+
+	static GLTrace *& active() {
+		static GLTrace * trace = nullptr;
+		return trace;
+	}
+
+	template<typename T>
+	void put(T const & value) {
+		static_assert(std::is_trivially_copyable<T>::value, "trace fields must be plain data");
+		char const * p = reinterpret_cast<char const *>(&value);
+		record_.insert(record_.end(), p, p + sizeof(T));
+	}
+	void put(trace_blob const & blob) {
+		put(blob.size);
+		char const * p = static_cast<char const *>(blob.data);
+		if(p != nullptr) record_.insert(record_.end(), p, p + blob.size);
+		else record_.insert(record_.end(), blob.size, 0);
+	}
+
+public:
+	GLTrace() : frames_(0), frame_limit_(0), bytes_(0) { }
+	GLTrace(GLTrace const &) = delete;
+	~GLTrace() { stop(); }
+
+	// the trace being recorded, if any
+	static GLTrace * recording() { return active(); }
+
+	// records every call until `frames` frames have ended
+	bool start(std::string const & path, size_t frames) {
+		out_.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if(!out_) {
+			std::cerr << "could not open trace '" << path << "'\n";
+			return false;
+		}
+
+		trace_header header = { trace_magic, trace_version };
+		out_.write(reinterpret_cast<char const *>(&header), sizeof(header));
+		bytes_ = sizeof(header);
+
+		frames_ = 0;
+		frame_limit_ = frames;
+		active() = this;
+		return true;
+	}
+
+	void stop() {
+		if(active() == this) active() = nullptr;
+		if(out_.is_open()) out_.close();
+	}
+
+	size_t frames() const { return frames_; }
+	size_t bytes() const { return bytes_; }
+
+	template<typename... Args>
+	void record(TraceOp op, Args const &... args) {
+		record_.clear();
+		(put(args), ...);
+
+		uint32_t header[2] = { uint32_t(op), uint32_t(record_.size()) };
+		out_.write(reinterpret_cast<char const *>(header), sizeof(header));
+		out_.write(record_.data(), record_.size());
+		bytes_ += sizeof(header) + record_.size();
+
+		if(op == TraceOp::frame_end && ++frames_ >= frame_limit_) {
+			stop();
+		}
+	}
+};
+
+// records a call when a trace is running, costs one branch otherwise
+#define GL_TRACE(op, ...) \
+	do { if(GLTrace * gl_trace__ = GLTrace::recording()) gl_trace__->record(TraceOp::op, ##__VA_ARGS__); } while(0)
+
+// reads back the records written by GLTrace
+class TraceReader {
+private:
+	std::vector<char> data_;
+	size_t position_;
+	size_t record_end_;
+
+public:
+	TraceReader() : position_(0), record_end_(0) { }
+
+	bool open(std::string const & path) {
+		std::ifstream in(path, std::ios::in | std::ios::binary | std::ios::ate);
+		if(!in) return false;
+
+		data_.resize(in.tellg());
+		in.seekg(0);
+		in.read(data_.data(), data_.size());
+
+		trace_header header;
+		if(data_.size() < sizeof(header)) return false;
+		memcpy(&header, data_.data(), sizeof(header));
+		rewind();
+		return header.magic == trace_magic && header.version == trace_version;
+	}
+
+	size_t size() const { return data_.size(); }
+	void rewind() { position_ = record_end_ = sizeof(trace_header); }
+	size_t tell() const { return record_end_; }
+	void seek(size_t position) { position_ = record_end_ = position; }
+
+	// moves to the next record, skipping whatever is left of the current one
+	bool next(TraceOp & op) {
+		position_ = record_end_;
+		uint32_t header[2];
+		if(position_ + sizeof(header) > data_.size()) return false;
+
+		memcpy(header, data_.data() + position_, sizeof(header));
+		position_ += sizeof(header);
+		record_end_ = position_ + header[1];
+		if(record_end_ > data_.size()) return false;
+
+		op = TraceOp(header[0]);
+		return true;
+	}
+
+	template<typename T>
+	T get() {
+		T value{};
+		if(position_ + sizeof(T) <= record_end_) {
+			memcpy(&value, data_.data() + position_, sizeof(T));
+		}
+		position_ += sizeof(T);
+		return value;
+	}
+
+	// pointer into the trace, valid while the reader lives
+	void const * get_blob(uint32_t & size) {
+		size = get<uint32_t>();
+		void const * p = data_.data() + position_;
+		position_ += size;
+		return position_ <= record_end_ ? p : nullptr;
+	}
+	std::string get_string() {
+		uint32_t size;
+		char const * p = static_cast<char const *>(get_blob(size));
+		return p != nullptr ? std::string(p, size) : std::string();
+	}
+};
+
+#endif
@@ -0,0 +1,199 @@
+#ifndef __LOADER_HPP__
+#define __LOADER_HPP__
+
+#include "thread_pool.hpp"
+
+#include <stb/stb_image.h>
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <csetjmp>
+
+#ifdef HAVE_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+// decodes an image file into tightly packed 8 bit pixels.  returns nullptr on
+// failure, otherwise a buffer to be released with stbi_image_free
+typedef std::function<unsigned char *(std::string const &, int *, int *, int *, int)> image_loader;
+
+inline unsigned char * load_full_image(std::string const & path, int * width, int * height, int * channels, int desired_channels) {
+    return stbi_load(path.c_str(), width, height, channels, desired_channels);
+}
+
+#ifdef HAVE_LIBJPEG
+namespace detail {
+    struct jpeg_jump_error {
+        jpeg_error_mgr mgr;
+        std::jmp_buf jump;
+    };
+
+    inline void jpeg_jump_exit(j_common_ptr info) {
+        std::longjmp(reinterpret_cast<jpeg_jump_error *>(info->err)->jump, 1);
+    }
+}
+#endif
+
+// decodes a reduced resolution preview of the file.  for baseline jpegs this
+// is a 1/8 scale decode, which only reconstructs the DC coefficient of each
+// block and skips the inverse DCT.  other formats have no cheap preview and
+// return nullptr.
+inline unsigned char * load_preview_image(std::string const & path, int * width, int * height, int * channels, int desired_channels) {
+#ifdef HAVE_LIBJPEG
+    if(desired_channels != 3) return nullptr;
+
+    FILE * file = fopen(path.c_str(), "rb");
+    if(file == nullptr) return nullptr;
+
+    jpeg_decompress_struct info;
+    detail::jpeg_jump_error err;
+    unsigned char * volatile pixels = nullptr;
+
+    info.err = jpeg_std_error(&err.mgr);
+    err.mgr.error_exit = detail::jpeg_jump_exit;
+
+    if(setjmp(err.jump)) {
+        // not a jpeg, or a corrupt one
+        jpeg_destroy_decompress(&info);
+        fclose(file);
+        if(pixels != nullptr) stbi_image_free(pixels);
+        return nullptr;
+    }
+
+    jpeg_create_decompress(&info);
+    jpeg_stdio_src(&info, file);
+    jpeg_read_header(&info, TRUE);
+
+    info.scale_num = 1;
+    info.scale_denom = 8;
+    info.out_color_space = JCS_RGB;
+    info.dct_method = JDCT_IFAST;
+    info.do_fancy_upsampling = FALSE;
+
+    jpeg_start_decompress(&info);
+
+    size_t stride = info.output_width * 3;
+    // allocated with malloc so callers can release every image with stbi_image_free
+    pixels = static_cast<unsigned char *>(malloc(stride * info.output_height));
+
+    while(info.output_scanline < info.output_height) {
+        JSAMPROW row = pixels + info.output_scanline * stride;
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+
+    *width = info.output_width;
+    *height = info.output_height;
+    *channels = 3;
+
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    fclose(file);
+
+    return pixels;
+#else
+    (void)path; (void)width; (void)height; (void)channels; (void)desired_channels;
+    return nullptr;
+#endif
+}
+
+// decodes images on worker threads and hands the results back to the thread
+// that owns the GL context.  each job runs its decode step on a worker and
+// returns an upload step, which poll() runs on the calling thread.
+class AsyncLoader {
+private:
+    typedef std::chrono::steady_clock clock;
+
+    std::mutex mutex_;
+    std::vector<std::function<void()>> ready_;
+    std::atomic<size_t> outstanding_;
+    std::function<void()> notify_;
+
+    clock::time_point started_;
+    double first_frame_ms_;
+    double full_quality_ms_;
+
+    // last, so the workers are joined before the state they report into goes away
+    ThreadPool pool_;
+
+    double elapsed_ms() const {
+        return std::chrono::duration<double, std::milli>(clock::now() - started_).count();
+    }
+
+public:
+    // the times reported are measured from `started`, which should be taken
+    // as the program starts so window and context creation are counted too
+    AsyncLoader(clock::time_point started, size_t threads = ThreadPool::default_size())
+        : outstanding_(0), started_(started), 
+          first_frame_ms_(-1), full_quality_ms_(-1), pool_(threads)
+    { }
+    AsyncLoader(size_t threads = ThreadPool::default_size())
+        : AsyncLoader(clock::now(), threads)
+    { }
+
+    ~AsyncLoader() {
+        cancel();
+    }
+
+    // abandons decodes that have not started and waits for the rest.  uploads
+    // that were never polled are dropped
+    void cancel() {
+        pool_.clear();
+        pool_.wait();
+    }
+
+    // called from a worker whenever an upload becomes ready, e.g. to wake an
+    // event loop that is blocked waiting for input
+    void on_ready(std::function<void()> notify) { notify_ = notify; }
+
+    void submit(std::function<std::function<void()>()> decode) {
+        outstanding_++;
+        pool_.submit([this, decode]() {
+            auto upload = decode();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ready_.push_back(upload);
+            }
+            if(notify_) notify_();
+        });
+    }
+
+    // runs every finished upload step.  must be called from the GL thread
+    size_t poll() {
+        std::vector<std::function<void()>> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ready.swap(ready_);
+        }
+
+        for(auto const & upload : ready) {
+            if(upload) upload();
+            outstanding_--;
+        }
+
+        if(!ready.empty() && done() && full_quality_ms_ < 0) {
+            full_quality_ms_ = elapsed_ms();
+        }
+        return ready.size();
+    }
+
+    bool done() const { return outstanding_ == 0; }
+    size_t outstanding() const { return outstanding_; }
+
+    // call after each buffer swap
+    void frame_presented() {
+        if(first_frame_ms_ < 0) {
+            first_frame_ms_ = elapsed_ms();
+            if(done()) full_quality_ms_ = first_frame_ms_;
+        }
+    }
+
+    double time_to_first_frame_ms() const { return first_frame_ms_; }
+    double time_to_full_quality_ms() const { return full_quality_ms_; }
+};
+
+#endif
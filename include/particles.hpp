@@ -0,0 +1,112 @@
+#ifndef __PARTICLES_HPP__
+#define __PARTICLES_HPP__
+
+#include <glm/vec3.hpp> // glm::vec3
+#include <glm/ext/scalar_constants.hpp> // glm::pi
+
+#include "thread_pool.hpp"
+
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdint>
+
+// sine and cosine of an angle given in turns, to about 1e-6.  folds the
+// angle to within an eighth of a turn of a quadrant and evaluates short
+// series there, several times cheaper than the library calls
+inline void sincos_turns(double turns, float & s, float & c) {
+    double whole = turns - double(int64_t(turns));
+    if(whole < 0.) whole += 1.;
+    float x = float(whole) * 4.f;
+    int quadrant = int(x + 0.5f);
+    float a = (x - quadrant) * (0.5f * glm::pi<float>());
+    float a2 = a * a;
+    float sa = a * (1.f - a2 * (1.f / 6.f - a2 * (1.f / 120.f - a2 * (1.f / 5040.f))));
+    float ca = 1.f - a2 * (0.5f - a2 * (1.f / 24.f - a2 * (1.f / 720.f - a2 * (1.f / 40320.f))));
+    // arithmetic rather than branches, the quadrants come in random order
+    float odd = float(quadrant & 1);
+    float s1 = sa + odd * (ca - sa);
+    float c1 = ca + odd * (sa - ca);
+    s = s1 * (1.f - float(quadrant & 2));
+    c = c1 * (1.f - float((quadrant + 1) & 2));
+}
+
+// a ring or belt of small bodies on circular orbits around one parent, in
+// the x/z plane like Orbit.  kept as one array per field so propagating
+// streams through memory and the sizes can go to the GPU as they are
+class ParticleField {
+private:
+    std::vector<float> orbit_radius_;
+    std::vector<float> height_;   // offset out of the ring plane
+    std::vector<double> phase_;   // turns at t = 0
+    std::vector<double> rate_;    // turns per second
+    std::vector<float> size_;     // radius, same units as the bodies
+    // below this many particles the pool costs more than it saves
+    size_t parallel_threshold_;
+
+public:
+    ParticleField() : parallel_threshold_(16384) { }
+
+    // `count` particles spread evenly in area between `inner` and `outer`,
+    // `thickness` deep, each orbiting `period` seconds at the inner edge and
+    // slower further out as Kepler has it
+    static ParticleField ring(size_t count, float inner, float outer, float thickness, double period,
+                              float min_size, float max_size, uint32_t seed = 1)
+    {
+        ParticleField field;
+        field.orbit_radius_.resize(count);
+        field.height_.resize(count);
+        field.phase_.resize(count);
+        field.rate_.resize(count);
+        field.size_.resize(count);
+
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+        double inner_rate = 1. / period;
+        for(size_t i = 0; i < count; i++) {
+            float r = std::sqrt(inner * inner + unit(rng) * (outer * outer - inner * inner));
+            field.orbit_radius_[i] = r;
+            field.height_[i] = (unit(rng) - 0.5f) * thickness;
+            field.phase_[i] = unit(rng);
+            field.rate_[i] = inner_rate * std::pow(double(inner) / r, 1.5);
+            // many small ones, few large
+            float s = unit(rng);
+            field.size_[i] = min_size + (max_size - min_size) * s * s * s;
+        }
+        return field;
+    }
+
+    size_t size() const { return orbit_radius_.size(); }
+    float const * sizes() const { return size_.data(); }
+
+    // writes x, y, z of every particle at time t (seconds) into `xyz`.  the
+    // angle is reduced to a fraction of a turn in double so that long runs
+    // keep their precision, the rest is float
+    void propagate(double t, glm::vec3 center, float * xyz, ThreadPool * pool = nullptr) const {
+        size_t count = size();
+
+        // locals, so the stores through xyz cannot alias anything the loop reads
+        auto positions = [=, this](size_t begin, size_t end) {
+            double const * phase = phase_.data();
+            double const * rate = rate_.data();
+            float const * radius = orbit_radius_.data();
+            float const * height = height_.data();
+            float cx = center.x, cy = center.y, cz = center.z;
+            for(size_t i = begin; i < end; i++) {
+                float s, c;
+                sincos_turns(phase[i] + rate[i] * t, s, c);
+                float r = radius[i];
+                xyz[3 * i + 0] = cx + r * c;
+                xyz[3 * i + 1] = cy + height[i];
+                xyz[3 * i + 2] = cz - r * s;
+            }
+        };
+        if(pool != nullptr && count >= parallel_threshold_) {
+            parallel_for(*pool, count, (count + pool->size()) / (pool->size() + 1), positions);
+        } else {
+            positions(0, count);
+        }
+    }
+};
+
+#endif
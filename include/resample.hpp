@@ -0,0 +1,253 @@
+#ifndef __RESAMPLE_HPP__
+#define __RESAMPLE_HPP__
+
+#include "thread_pool.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define RESAMPLE_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RESAMPLE_NEON 1
+#endif
+
+// separable resampling of 8 bit images with 1 to 4 interleaved channels, to
+// any size in either direction.  each output row is the weighted sum of a few
+// source rows, done across the whole row at once (AVX2 or NEON), then each
+// pixel of that row the weighted sum of a few of its neighbours (SSE or NEON,
+// all channels in one register).  rows are split across a thread pool.
+// filters widen when shrinking, so downsampling averages instead of aliasing.
+
+enum class ResampleFilter { box, triangle, catmull_rom, mitchell, lanczos3 };
+
+namespace detail {
+
+    inline float resample_cubic(float x, float b, float c) {
+        x = std::abs(x);
+        if(x < 1.f) {
+            return ((12.f - 9.f * b - 6.f * c) * x * x * x + (-18.f + 12.f * b + 6.f * c) * x * x + (6.f - 2.f * b)) / 6.f;
+        }
+        if(x < 2.f) {
+            return ((-b - 6.f * c) * x * x * x + (6.f * b + 30.f * c) * x * x + (-12.f * b - 48.f * c) * x + (8.f * b + 24.f * c)) / 6.f;
+        }
+        return 0.f;
+    }
+
+    inline float resample_sinc(float x) {
+        if(x == 0.f) return 1.f;
+        x *= 3.14159265358979f;
+        return std::sin(x) / x;
+    }
+
+    inline float resample_support(ResampleFilter filter) {
+        switch(filter) {
+        case ResampleFilter::box: return 0.5f;
+        case ResampleFilter::triangle: return 1.f;
+        case ResampleFilter::lanczos3: return 3.f;
+        default: return 2.f;
+        }
+    }
+
+    inline float resample_kernel(ResampleFilter filter, float x) {
+        switch(filter) {
+        case ResampleFilter::box: return std::abs(x) <= 0.5f ? 1.f : 0.f;
+        case ResampleFilter::triangle: return std::max(0.f, 1.f - std::abs(x));
+        case ResampleFilter::catmull_rom: return resample_cubic(x, 0.f, 0.5f);
+        case ResampleFilter::mitchell: return resample_cubic(x, 1.f / 3.f, 1.f / 3.f);
+        case ResampleFilter::lanczos3: return std::abs(x) < 3.f ? resample_sinc(x) * resample_sinc(x / 3.f) : 0.f;
+        }
+        return 0.f;
+    }
+
+    // which source samples make up each of `out` samples along one axis of
+    // `in`, as `taps` weights from `first`.  samples past the edges are
+    // folded onto the edge, so every run of taps stays inside the source
+    struct resample_axis {
+        int taps;
+        std::vector<int> first;
+        std::vector<float> weights;
+
+        resample_axis(int in, int out, ResampleFilter filter) : taps(1), first(out), weights() {
+            float scale = float(out) / in;
+            float widen = std::max(1.f, 1.f / scale);
+            float support = resample_support(filter) * widen;
+
+            std::vector<std::vector<float>> contributions(out);
+            std::vector<int> lowest(out);
+            for(int i = 0; i < out; i++) {
+                float center = (i + 0.5f) / scale;
+                int lo = int(std::floor(center - support)), hi = int(std::ceil(center + support));
+                int jmin = std::clamp(lo, 0, in - 1), jmax = std::clamp(hi, 0, in - 1);
+                std::vector<float> w(jmax - jmin + 1, 0.f);
+                float sum = 0.f;
+                for(int j = lo; j <= hi; j++) {
+                    float k = resample_kernel(filter, (j + 0.5f - center) / widen);
+                    w[std::clamp(j, 0, in - 1) - jmin] += k;
+                    sum += k;
+                }
+                if(sum != 0.f) for(float & v : w) v /= sum;
+
+                // drop zero weights at either end
+                size_t a = 0, b = w.size();
+                while(a + 1 < b && w[a] == 0.f) a++;
+                while(b - 1 > a && w[b - 1] == 0.f) b--;
+                contributions[i].assign(w.begin() + a, w.begin() + b);
+                lowest[i] = jmin + int(a);
+                taps = std::max(taps, int(b - a));
+            }
+
+            taps = std::min(taps, in);
+            weights.assign(size_t(out) * taps, 0.f);
+            for(int i = 0; i < out; i++) {
+                first[i] = std::min(lowest[i], in - taps);
+                int offset = lowest[i] - first[i];
+                std::copy(contributions[i].begin(), contributions[i].end(), weights.begin() + size_t(i) * taps + offset);
+            }
+        }
+    };
+
+    inline bool resample_avx2() {
+#if RESAMPLE_X86
+        static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+#if RESAMPLE_X86
+    __attribute__((target("avx2,fma")))
+    inline void resample_accumulate_avx2(float * acc, uint8_t const * src, float w, size_t n) {
+        __m256 wv = _mm256_set1_ps(w);
+        size_t i = 0;
+        for(; i + 8 <= n; i += 8) {
+            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<__m128i const *>(src + i));
+            __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+            _mm256_storeu_ps(acc + i, _mm256_fmadd_ps(v, wv, _mm256_loadu_ps(acc + i)));
+        }
+        for(; i < n; i++) acc[i] += w * src[i];
+    }
+#endif
+
+    // acc[i] += w * src[i]
+    inline void resample_accumulate(float * acc, uint8_t const * src, float w, size_t n, bool simd) {
+#if RESAMPLE_X86
+        if(simd && resample_avx2()) {
+            resample_accumulate_avx2(acc, src, w, n);
+            return;
+        }
+#elif RESAMPLE_NEON
+        if(simd) {
+            float32x4_t wv = vdupq_n_f32(w);
+            size_t i = 0;
+            for(; i + 8 <= n; i += 8) {
+                uint16x8_t v16 = vmovl_u8(vld1_u8(src + i));
+                float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(v16)));
+                float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(v16)));
+                vst1q_f32(acc + i, vmlaq_f32(vld1q_f32(acc + i), lo, wv));
+                vst1q_f32(acc + i + 4, vmlaq_f32(vld1q_f32(acc + i + 4), hi, wv));
+            }
+            for(; i < n; i++) acc[i] += w * src[i];
+            return;
+        }
+#endif
+        for(size_t i = 0; i < n; i++) acc[i] += w * src[i];
+    }
+
+    // one output row from a row of vertically filtered samples, padded by 4
+    // floats so every pixel can be loaded as a whole register
+    inline void resample_row(float const * row, uint8_t * dst, resample_axis const & x_axis, int channels, bool simd) {
+        int out = int(x_axis.first.size());
+        int taps = x_axis.taps;
+#if RESAMPLE_X86 || RESAMPLE_NEON
+        if(simd) {
+            for(int i = 0; i < out; i++) {
+                float const * w = &x_axis.weights[size_t(i) * taps];
+                float const * src = row + size_t(x_axis.first[i]) * channels;
+#if RESAMPLE_X86
+                __m128 acc = _mm_setzero_ps();
+                for(int k = 0; k < taps; k++) {
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w[k]), _mm_loadu_ps(src + k * channels)));
+                }
+                __m128i v = _mm_cvtps_epi32(acc);
+                v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+                uint32_t bytes = uint32_t(_mm_cvtsi128_si32(v));
+#else
+                float32x4_t acc = vdupq_n_f32(0.f);
+                for(int k = 0; k < taps; k++) {
+                    acc = vmlaq_n_f32(acc, vld1q_f32(src + k * channels), w[k]);
+                }
+                uint16x4_t v16 = vqmovun_s32(vcvtnq_s32_f32(acc));
+                uint8x8_t v8 = vqmovn_u16(vcombine_u16(v16, v16));
+                uint32_t bytes = vget_lane_u32(vreinterpret_u32_u8(v8), 0);
+#endif
+                std::memcpy(dst + size_t(i) * channels, &bytes, channels);
+            }
+            return;
+        }
+#endif
+        for(int i = 0; i < out; i++) {
+            float const * w = &x_axis.weights[size_t(i) * taps];
+            float const * src = row + size_t(x_axis.first[i]) * channels;
+            for(int c = 0; c < channels; c++) {
+                float acc = 0.f;
+                for(int k = 0; k < taps; k++) acc += w[k] * src[k * channels + c];
+                dst[size_t(i) * channels + c] = uint8_t(std::clamp(std::nearbyint(acc), 0.f, 255.f));
+            }
+        }
+    }
+}
+
+// what stb_image_resize picks: Mitchell to shrink, Catmull-Rom to enlarge
+inline ResampleFilter resample_default_filter(int src_width, int src_height, int dst_width, int dst_height) {
+    return size_t(dst_width) * dst_height < size_t(src_width) * src_height ? ResampleFilter::mitchell : ResampleFilter::catmull_rom;
+}
+
+// for callers on threads that belong to some other pool
+inline ThreadPool & resample_pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// resizes `src` (tightly packed rows) into `dst`, which holds
+// dst_width * dst_height * channels bytes.  `simd` off is for comparisons
+inline void resample(uint8_t const * src, int src_width, int src_height,
+                     uint8_t * dst, int dst_width, int dst_height, int channels,
+                     ResampleFilter filter, ThreadPool * pool = nullptr, bool simd = true)
+{
+    if(src_width == dst_width && src_height == dst_height) {
+        std::memcpy(dst, src, size_t(src_width) * src_height * channels);
+        return;
+    }
+
+    detail::resample_axis x_axis(src_width, dst_width, filter);
+    detail::resample_axis y_axis(src_height, dst_height, filter);
+    size_t src_stride = size_t(src_width) * channels;
+    size_t dst_stride = size_t(dst_width) * channels;
+
+    auto rows = [&](size_t begin, size_t end) {
+        std::vector<float> row(src_stride + 4);
+        for(size_t y = begin; y < end; y++) {
+            std::fill(row.begin(), row.end(), 0.f);
+            float const * w = &y_axis.weights[y * y_axis.taps];
+            for(int k = 0; k < y_axis.taps; k++) {
+                if(w[k] == 0.f) continue;
+                detail::resample_accumulate(row.data(), src + size_t(y_axis.first[y] + k) * src_stride, w[k], src_stride, simd);
+            }
+            detail::resample_row(row.data(), dst + y * dst_stride, x_axis, channels, simd);
+        }
+    };
+    if(pool != nullptr) {
+        parallel_for(*pool, dst_height, std::max<size_t>(8, dst_height / (4 * (pool->size() + 1))), rows);
+    } else {
+        rows(0, dst_height);
+    }
+}
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef __SCENE_HPP__
+#define __SCENE_HPP__
+
+#include <glm/vec3.hpp> // glm::vec3
+#include <glm/vec4.hpp> // glm::vec4
+#include <glm/mat4x4.hpp> // glm::mat4
+#include <glm/ext/matrix_transform.hpp> // glm::translate, glm::rotate
+#include <glm/ext/matrix_clip_space.hpp> // glm::perspective
+#include <glm/ext/scalar_constants.hpp> // glm::pi
+
+#include "thread_pool.hpp"
+#include "eclipse.hpp"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// circular orbit in the x/z plane around a parent body
+class Orbit {
+private:
+    float radius_;   // distance from the parent
+    double period_;  // seconds per revolution, 0 for a fixed offset
+    float phase_;    // radians at t = 0
+
+public:
+    Orbit(float radius, double period = 0., float phase = 0.f)
+        : radius_(radius), period_(period), phase_(phase)
+    { }
+
+    float radius() const { return radius_; }
+    double period() const { return period_; }
+
+    // offset from the parent at time t (seconds)
+    glm::vec3 operator()(double t) const {
+        double angle = phase_;
+        if(period_ != 0.) {
+            angle += 2. * glm::pi<double>() * t / period_;
+        }
+        return glm::vec3(radius_ * glm::cos(angle), 0.f, -radius_ * glm::sin(angle));
+    }
+};
+
+struct Body {
+    std::string name;
+    float radius;
+    Orbit orbit;
+    int parent; // index of the body orbited, -1 for the scene origin
+};
+
+// a further camera on the same scene, drawn into its own part of the frame
+struct View {
+    glm::mat4 projection;
+    float viewport_height;  // pixels
+    int follow;             // body the camera circles, -1 for the scene origin
+    float distance;         // from that body
+};
+
+// where one view looks from at one step
+struct ViewState {
+    glm::mat4 view;
+    glm::mat4 view_projection;
+    glm::mat4 inverse_view_projection;
+    glm::vec3 camera;
+};
+
+// everything the renderer needs from one simulation step
+struct SceneState {
+    double time;
+    glm::mat4 view;
+    glm::mat4 view_projection;
+    glm::mat4 inverse_view_projection;
+    glm::vec3 camera;
+    // every view, the first being the scene's own camera above
+    std::vector<ViewState> views;
+    glm::vec3 sun;
+    std::vector<glm::vec3> position;
+    std::vector<float> radius;
+    // radius of each body in pixels in the view it is largest in, 0 when
+    // behind every camera
+    std::vector<float> pixel_radius;
+    // bodies that may be eclipsing another one this step
+    std::vector<ShadowPair> shadows;
+    size_t shadow_tests;
+};
+
+class Scene {
+private:
+    std::vector<Body> bodies_;
+    std::vector<View> views_;
+    glm::mat4 projection_;
+    // below this many bodies the orbits are cheaper to evaluate inline
+    size_t parallel_threshold_;
+    float sun_angular_radius_;
+    float viewport_height_; // pixels
+
+public:
+    Scene(glm::mat4 const & projection)
+        : projection_(projection), parallel_threshold_(256), sun_angular_radius_(0.02f),
+          viewport_height_(1080.f)
+    { }
+
+    // bodies must be added after their parent
+    size_t add(Body const & body) {
+        bodies_.push_back(body);
+        return bodies_.size() - 1;
+    }
+
+    std::vector<Body> const & bodies() const { return bodies_; }
+    size_t size() const { return bodies_.size(); }
+
+    // views after the scene's own camera, which is view 0 in the state
+    size_t add_view(View const & view) {
+        views_.push_back(view);
+        return views_.size();
+    }
+    std::vector<View> const & views() const { return views_; }
+    void set_view_projection(size_t view, glm::mat4 const & projection, float viewport_height) {
+        views_[view - 1].projection = projection;
+        views_[view - 1].viewport_height = viewport_height;
+    }
+
+    glm::mat4 const & projection() const { return projection_; }
+    void set_projection(glm::mat4 const & projection) { projection_ = projection; }
+    // radians, sets the width of the penumbra
+    float sun_angular_radius() const { return sun_angular_radius_; }
+    void set_sun_angular_radius(float radius) { sun_angular_radius_ = radius; }
+    // pixels, for the projected size of each body
+    float viewport_height() const { return viewport_height_; }
+    void set_viewport_height(float height) { viewport_height_ = height; }
+
+    // camera and sun paths
+    glm::mat4 view_at(double t) const {
+        glm::mat4 view = glm::identity<glm::mat4>();
+        view = glm::translate(view, glm::vec3(0, 0, -10.));
+        view = glm::rotate(view, (float)t / (float)400., glm::vec3(0, 0.5, 0));
+        // view = glm::rotate(view, (float)t / (float)65., glm::vec3(0, 0, 1));
+        return view;
+    }
+    // the same path around `center` at `distance`
+    glm::mat4 view_at(double t, glm::vec3 center, float distance) const {
+        glm::mat4 view = glm::identity<glm::mat4>();
+        view = glm::translate(view, glm::vec3(0, 0, -distance));
+        view = glm::rotate(view, (float)t / (float)400., glm::vec3(0, 0.5, 0));
+        return glm::translate(view, -center);
+    }
+    glm::vec3 sun_at(double t) const {
+        return glm::vec3(
+            glm::cos((float)t / (float)60.),
+            0.,
+            -glm::sin((float)t / (float)60.));
+    }
+
+    void body_positions(double t, glm::vec3 * position, ThreadPool * pool = nullptr) const {
+        size_t count = bodies_.size();
+
+        // orbit offsets are independent of each other
+        auto offsets = [&](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++) {
+                position[i] = bodies_[i].orbit(t);
+            }
+        };
+        if(pool != nullptr && count >= parallel_threshold_) {
+            parallel_for(*pool, count, (count + pool->size()) / (pool->size() + 1), offsets);
+        } else {
+            offsets(0, count);
+        }
+
+        // parents come first, so one pass resolves the hierarchy
+        for(size_t i = 0; i < count; i++) {
+            if(bodies_[i].parent >= 0) {
+                position[i] += position[bodies_[i].parent];
+            }
+        }
+    }
+
+    void update(double t, SceneState & state, ThreadPool * pool = nullptr) const {
+        state.time = t;
+        state.view = view_at(t);
+        state.view_projection = projection_ * state.view;
+        state.inverse_view_projection = glm::inverse(state.view_projection);
+        state.camera = glm::inverse(state.view) * glm::vec4(0, 0, 0, 1);
+        state.sun = sun_at(t);
+
+        state.position.resize(bodies_.size());
+        state.radius.resize(bodies_.size());
+        for(size_t i = 0; i < bodies_.size(); i++) {
+            state.radius[i] = bodies_[i].radius;
+        }
+        body_positions(t, state.position.data(), pool);
+
+        state.views.resize(1 + views_.size());
+        state.views[0] = { state.view, state.view_projection, state.inverse_view_projection, state.camera };
+        for(size_t v = 0; v < views_.size(); v++) {
+            View const & view = views_[v];
+            ViewState & out = state.views[v + 1];
+            glm::vec3 center = view.follow >= 0 ? state.position[view.follow] : glm::vec3(0.f);
+            out.view = view_at(t, center, view.distance);
+            out.view_projection = view.projection * out.view;
+            out.inverse_view_projection = glm::inverse(out.view_projection);
+            out.camera = glm::inverse(out.view) * glm::vec4(0, 0, 0, 1);
+        }
+
+        // a sphere at distance d subtends tan(a) = R / sqrt(d^2 - R^2), which
+        // the projection scales to pixels the same way as the y axis
+        state.pixel_radius.assign(bodies_.size(), 0.f);
+        for(size_t v = 0; v < state.views.size(); v++) {
+            glm::mat4 const & projection = v == 0 ? projection_ : views_[v - 1].projection;
+            float viewport_height = v == 0 ? viewport_height_ : views_[v - 1].viewport_height;
+            float pixels_per_unit = projection[1][1] * 0.5f * viewport_height;
+            for(size_t i = 0; i < bodies_.size(); i++) {
+                glm::vec3 center = state.views[v].view * glm::vec4(state.position[i], 1.f);
+                float r = state.radius[i];
+                float d2 = glm::dot(center, center);
+                float pixels;
+                if(d2 <= r * r) {
+                    pixels = viewport_height;
+                } else if(center.z > r) {
+                    pixels = 0.f;
+                } else {
+                    pixels = pixels_per_unit * r / std::sqrt(d2 - r * r);
+                }
+                state.pixel_radius[i] = std::max(state.pixel_radius[i], pixels);
+            }
+        }
+
+        state.shadow_tests = find_shadow_pairs(state.position.data(), state.radius.data(), bodies_.size(),
+                                               state.sun, sun_angular_radius_, state.shadows);
+    }
+};
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef __SEQUENCE_HPP__
+#define __SEQUENCE_HPP__
+
+#include "thread_pool.hpp"
+#include "loader.hpp"
+#include "resample.hpp"
+
+#include <stb/stb_image.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include <cstdint>
+
+// plays a sequence of image files as an animated texture.  frames are
+// decoded ahead of playback on a pool of its own into a fixed ring of slots,
+// each resized to one common size, so memory stays at `ahead` frames however
+// long the sequence is.  playback follows the time passed to update(), not
+// the frame rate it is called at: frames that come up while the renderer is
+// elsewhere are dropped, frames that are not decoded when they come up are
+// late and the previous one stays on screen.  loops at the end.
+class SequenceSource {
+private:
+    enum { empty, decoding, ready, failed };
+
+    struct slot {
+        int64_t frame;              // position in playback, not wrapped
+        std::atomic<int> state;
+        std::vector<unsigned char> pixels;
+        slot() : frame(-1), state(empty) { }
+    };
+
+    std::vector<std::string> paths_;
+    double rate_;
+    int width_;
+    int height_;
+    std::vector<std::unique_ptr<slot>> slots_;
+
+    int64_t shown_frame_;
+    int64_t late_frame_;
+    size_t shown_;
+    size_t late_;
+    size_t dropped_;
+    size_t failures_;
+
+    // last, so the workers are joined before the slots they write go away
+    ThreadPool pool_;
+
+    slot * find(int64_t frame) const {
+        for(auto const & s : slots_) {
+            if(s->frame == frame && s->state != empty) return s.get();
+        }
+        return nullptr;
+    }
+
+    void decode(slot * s, std::string const & path) const {
+        int w, h, c;
+        unsigned char * pixels = load_full_image(path, &w, &h, &c, 3);
+        if(pixels == nullptr) {
+            s->state.store(failed, std::memory_order_release);
+            return;
+        }
+        // one frame per worker already, so no pool for the resize
+        resample(pixels, w, h, s->pixels.data(), width_, height_, 3, resample_default_filter(w, h, width_, height_));
+        stbi_image_free(pixels);
+        s->state.store(ready, std::memory_order_release);
+    }
+
+    void start(slot * s, int64_t frame) {
+        s->frame = frame;
+        s->state.store(decoding, std::memory_order_relaxed);
+        pool_.submit([this, s, path = paths_[size_t(frame % int64_t(paths_.size()))]]() {
+            decode(s, path);
+        });
+    }
+
+    // blocks until a slot is done decoding and starts `frame` in it.  slots
+    // outside [due, end) go first, then the one furthest ahead
+    slot * start_waiting(int64_t frame, int64_t due, int64_t end) {
+        for(;;) {
+            slot * taken = nullptr;
+            int64_t taken_rank = -1;
+            for(auto const & s : slots_) {
+                if(s->state.load(std::memory_order_acquire) == decoding) continue;
+                int64_t rank = s->frame >= due && s->frame < end ? s->frame : INT64_MAX;
+                if(rank > taken_rank) {
+                    taken = s.get();
+                    taken_rank = rank;
+                }
+            }
+            if(taken != nullptr) {
+                start(taken, frame);
+                return taken;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+public:
+    // `paths` in playback order at `rate` frames per second, every frame
+    // resized to the first one's size
+    SequenceSource(std::vector<std::string> const & paths, double rate, size_t ahead = 8,
+                   size_t threads = ThreadPool::default_size())
+        : paths_(paths), rate_(rate), width_(0), height_(0),
+          shown_frame_(-1), late_frame_(-1), shown_(0), late_(0), dropped_(0), failures_(0),
+          pool_(threads)
+    {
+        int channels;
+        if(paths_.empty() || !stbi_info(paths_[0].c_str(), &width_, &height_, &channels)) {
+            if(!paths_.empty()) std::cerr << "could not open sequence frame '" << paths_[0] << "'\n";
+            paths_.clear();
+            return;
+        }
+        slots_.resize(std::max<size_t>(ahead, 2));
+        for(auto & s : slots_) {
+            s = std::make_unique<slot>();
+            s->pixels.resize(size_t(width_) * height_ * 3);
+        }
+    }
+    SequenceSource(SequenceSource const &) = delete;
+
+    ~SequenceSource() {
+        pool_.clear();
+        pool_.wait();
+    }
+
+    // the images in `directory` sorted by name, empty and a message if there are none
+    static std::vector<std::string> list(std::string const & directory) {
+        std::vector<std::string> paths;
+        std::error_code ec;
+        for(auto const & entry : std::filesystem::directory_iterator(directory, ec)) {
+            std::string ext = entry.path().extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if(ext == ".jpg" || ext == ".jpeg" || ext == ".png") paths.push_back(entry.path().string());
+        }
+        if(paths.empty()) {
+            std::cerr << "no frames in sequence directory '" << directory << "'\n";
+        }
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    bool is_valid() const { return !paths_.empty(); }
+    size_t frames() const { return paths_.size(); }
+    int width() const { return width_; }
+    int height() const { return height_; }
+    size_t bytes() const { return slots_.size() * size_t(width_) * height_ * 3; }
+
+    // schedules the decodes for the next frames after time t and returns the
+    // pixels of the frame due at t if they are new since the last call and
+    // decoded, nullptr otherwise.  with `wait` it blocks until the frame due
+    // is decoded instead, for renders that must not skip any.
+    // the pixels stay valid until the next call.  call from one thread only
+    unsigned char const * update(double t, bool wait = false) {
+        if(!is_valid()) return nullptr;
+        int64_t due = int64_t(std::floor(std::max(t, 0.) * rate_));
+        int64_t end = due + int64_t(slots_.size());
+
+        // recycle the slots that fell behind playback, or that a jump back
+        // in time left too far ahead; ones still decoding are left alone
+        for(auto & s : slots_) {
+            int state = s->state.load(std::memory_order_acquire);
+            if(state == decoding) continue;
+            if(state == failed && s->frame >= due && s->frame < end) continue;
+            if(state == empty || s->frame < due || s->frame >= end) {
+                s->frame = -1;
+                s->state.store(empty, std::memory_order_relaxed);
+            }
+        }
+
+        // fill free slots with the nearest missing frames first
+        auto free_slot = slots_.begin();
+        for(int64_t frame = due; frame < end; frame++) {
+            if(find(frame) != nullptr) continue;
+            free_slot = std::find_if(free_slot, slots_.end(), [](std::unique_ptr<slot> const & s) {
+                return s->state.load(std::memory_order_acquire) == empty;
+            });
+            if(free_slot == slots_.end()) break;
+
+            start(free_slot->get(), frame);
+        }
+
+        if(due == shown_frame_) return nullptr;
+        slot * s = find(due);
+        // every slot can still be busy with frames from before a jump in
+        // time, in which case the frame due waits for the first to finish
+        if(wait && s == nullptr) s = start_waiting(due, due, end);
+        int state = s != nullptr ? s->state.load(std::memory_order_acquire) : empty;
+        while(wait && state == decoding) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            state = s->state.load(std::memory_order_acquire);
+        }
+        if(state == failed) {
+            // counted once and skipped, the previous frame stays up
+            if(late_frame_ != due) failures_++;
+            late_frame_ = due;
+            return nullptr;
+        }
+        if(state != ready) {
+            if(late_frame_ != due) late_++;
+            late_frame_ = due;
+            return nullptr;
+        }
+
+        if(shown_frame_ >= 0 && due > shown_frame_ + 1) {
+            dropped_ += size_t(due - shown_frame_ - 1);
+        }
+        shown_frame_ = due;
+        shown_++;
+        return s->pixels.data();
+    }
+
+    // frames uploaded, frames that were not decoded in time when they came
+    // up, and frames never shown because playback passed them
+    size_t shown() const { return shown_; }
+    size_t late() const { return late_; }
+    size_t dropped() const { return dropped_; }
+    size_t failures() const { return failures_; }
+};
+
+#endif
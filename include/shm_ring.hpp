@@ -0,0 +1,304 @@
+#ifndef __SHM_RING_HPP__
+#define __SHM_RING_HPP__
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <ctime>
+#include <iostream>
+
+// frames published into a POSIX shared memory object.  the object holds a
+// ShmRingHeader followed by `slot_count` slots, each a ShmFrameHeader plus
+// `slot_size` bytes of pixels.  the writer never waits for readers: it cycles
+// through the slots and a per-slot sequence lock tells a reader whether the
+// slot was overwritten while it was looking at it.
+//
+// a reader maps the object read-only and works on the pixels in place:
+//
+//   ShmRingReader ring;
+//   ring.open("/gl_planets");
+//   ShmFrame frame;
+//   if(ring.acquire(frame, last)) {
+//       use(frame.pixels);
+//       if(ring.still_valid(frame)) last = frame.sequence;
+//   }
+
+static const uint32_t shm_ring_magic = 0x474c5052; // "GLPR"
+static const uint32_t shm_ring_version = 1;
+
+enum : uint32_t {
+    shm_format_rgba8 = 1,
+};
+enum : uint32_t {
+    // rows are stored bottom to top, as glReadPixels returns them
+    shm_flag_bottom_up = 1,
+};
+
+struct alignas(64) ShmRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    // sequence number of the newest complete frame, 0 before the first
+    std::atomic<uint64_t> latest;
+};
+
+struct alignas(64) ShmFrameHeader {
+    // even when the slot is stable, odd while the writer is filling it
+    std::atomic<uint64_t> lock;
+    uint64_t sequence;
+    uint64_t timestamp_ns; // CLOCK_MONOTONIC when the frame was rendered
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t format;
+    uint32_t flags;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory needs address free atomics");
+
+inline uint64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+inline size_t shm_slot_stride(uint32_t slot_size) {
+    return (sizeof(ShmFrameHeader) + slot_size + 63) & ~size_t(63);
+}
+
+// a frame as seen by a reader.  pixels point straight into the mapping
+struct ShmFrame {
+    uint64_t sequence;
+    uint64_t timestamp_ns;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t format;
+    uint32_t flags;
+    unsigned char const * pixels;
+
+    ShmFrameHeader const * header;
+    uint64_t lock;
+};
+
+class ShmRingWriter {
+private:
+    std::string name_;
+    void * map_;
+    size_t size_;
+    ShmRingHeader * header_;
+    uint64_t sequence_;
+
+    ShmFrameHeader * slot(uint64_t sequence) const {
+        size_t index = sequence % header_->slot_count;
+        return reinterpret_cast<ShmFrameHeader *>(
+            static_cast<unsigned char *>(map_) + sizeof(ShmRingHeader) + index * shm_slot_stride(header_->slot_size));
+    }
+
+public:
+    ShmRingWriter() : map_(nullptr), size_(0), header_(nullptr), sequence_(0) { }
+    ShmRingWriter(ShmRingWriter const &) = delete;
+    ~ShmRingWriter() { close(); }
+
+    // creates (or replaces) the shared memory object `name`, e.g. "/gl_planets"
+    bool create(std::string const & name, uint32_t slot_count, uint32_t slot_size) {
+        close();
+        if(slot_count < 2) slot_count = 2;
+
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+        if(fd < 0) {
+            std::cerr << "could not create shared memory '" << name << "': " << strerror(errno) << "\n";
+            return false;
+        }
+
+        size_ = sizeof(ShmRingHeader) + slot_count * shm_slot_stride(slot_size);
+        if(ftruncate(fd, size_) != 0) {
+            std::cerr << "could not size shared memory '" << name << "': " << strerror(errno) << "\n";
+            ::close(fd);
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        map_ = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(map_ == MAP_FAILED) {
+            std::cerr << "could not map shared memory '" << name << "': " << strerror(errno) << "\n";
+            map_ = nullptr;
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        name_ = name;
+        header_ = new (map_) ShmRingHeader;
+        // the object may be left over from an earlier run that readers still map
+        header_->magic = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+        header_->slot_count = slot_count;
+        header_->slot_size = slot_size;
+        header_->latest.store(0, std::memory_order_relaxed);
+        for(uint64_t i = 0; i < slot_count; i++) {
+            ShmFrameHeader * frame = new (slot(i)) ShmFrameHeader;
+            frame->lock.store(0, std::memory_order_relaxed);
+            frame->sequence = 0;
+        }
+        header_->version = shm_ring_version;
+        // readers check the magic last
+        std::atomic_thread_fence(std::memory_order_release);
+        header_->magic = shm_ring_magic;
+        return true;
+    }
+
+    void close() {
+        if(map_ == nullptr) return;
+
+        munmap(map_, size_);
+        shm_unlink(name_.c_str());
+        map_ = nullptr;
+        header_ = nullptr;
+    }
+
+    bool is_open() const { return map_ != nullptr; }
+    uint32_t slot_size() const { return header_->slot_size; }
+    uint64_t published() const { return sequence_; }
+
+    // starts the next frame and returns where its pixels go.  the pointer is
+    // valid until end_frame()
+    unsigned char * begin_frame(uint32_t width, uint32_t height, uint32_t stride, uint32_t format, uint32_t flags = 0) {
+        if(size_t(stride) * height > header_->slot_size) return nullptr;
+
+        ShmFrameHeader * frame = slot(sequence_ + 1);
+        uint64_t lock = frame->lock.load(std::memory_order_relaxed);
+        frame->lock.store(lock + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        frame->sequence = sequence_ + 1;
+        frame->width = width;
+        frame->height = height;
+        frame->stride = stride;
+        frame->format = format;
+        frame->flags = flags;
+        return reinterpret_cast<unsigned char *>(frame + 1);
+    }
+
+    void end_frame(uint64_t timestamp_ns) {
+        sequence_++;
+        ShmFrameHeader * frame = slot(sequence_);
+        frame->timestamp_ns = timestamp_ns;
+        frame->lock.store(frame->lock.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        header_->latest.store(sequence_, std::memory_order_release);
+    }
+
+    bool publish(unsigned char const * pixels, uint32_t width, uint32_t height, uint32_t stride,
+                 uint32_t format, uint32_t flags, uint64_t timestamp_ns)
+    {
+        unsigned char * dst = begin_frame(width, height, stride, format, flags);
+        if(dst == nullptr) return false;
+
+        memcpy(dst, pixels, size_t(stride) * height);
+        end_frame(timestamp_ns);
+        return true;
+    }
+};
+
+class ShmRingReader {
+private:
+    void * map_;
+    size_t size_;
+    ShmRingHeader const * header_;
+
+    ShmFrameHeader const * slot(uint64_t sequence) const {
+        size_t index = sequence % header_->slot_count;
+        return reinterpret_cast<ShmFrameHeader const *>(
+            static_cast<unsigned char const *>(map_) + sizeof(ShmRingHeader) + index * shm_slot_stride(header_->slot_size));
+    }
+
+public:
+    ShmRingReader() : map_(nullptr), size_(0), header_(nullptr) { }
+    ShmRingReader(ShmRingReader const &) = delete;
+    ~ShmRingReader() { close(); }
+
+    bool open(std::string const & name) {
+        close();
+
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if(fd < 0) return false;
+
+        struct stat st;
+        if(fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(ShmRingHeader)) {
+            ::close(fd);
+            return false;
+        }
+
+        size_ = st.st_size;
+        map_ = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(map_ == MAP_FAILED) {
+            map_ = nullptr;
+            return false;
+        }
+
+        header_ = static_cast<ShmRingHeader const *>(map_);
+        bool ready = header_->magic == shm_ring_magic;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(!ready || header_->version != shm_ring_version ||
+           sizeof(ShmRingHeader) + header_->slot_count * shm_slot_stride(header_->slot_size) > size_)
+        {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+        if(map_ == nullptr) return;
+
+        munmap(map_, size_);
+        map_ = nullptr;
+        header_ = nullptr;
+    }
+
+    bool is_open() const { return map_ != nullptr; }
+    uint64_t latest() const { return header_->latest.load(std::memory_order_acquire); }
+
+    // fills `frame` with the newest frame after `after`.  returns false if
+    // there is none yet or the writer is in the middle of replacing it
+    bool acquire(ShmFrame & frame, uint64_t after = 0) const {
+        uint64_t sequence = latest();
+        if(sequence == 0 || sequence <= after) return false;
+
+        ShmFrameHeader const * h = slot(sequence);
+        uint64_t lock = h->lock.load(std::memory_order_acquire);
+        if(lock & 1) return false;
+
+        frame.sequence = h->sequence;
+        frame.timestamp_ns = h->timestamp_ns;
+        frame.width = h->width;
+        frame.height = h->height;
+        frame.stride = h->stride;
+        frame.format = h->format;
+        frame.flags = h->flags;
+        frame.pixels = reinterpret_cast<unsigned char const *>(h + 1);
+        frame.header = h;
+        frame.lock = lock;
+
+        return still_valid(frame) && frame.sequence == sequence;
+    }
+
+    // true if the writer has not touched the frame's slot since acquire().
+    // call after using the pixels; if it fails they may have been torn
+    bool still_valid(ShmFrame const & frame) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return frame.header->lock.load(std::memory_order_relaxed) == frame.lock;
+    }
+};
+
+#endif
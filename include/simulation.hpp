@@ -0,0 +1,120 @@
+#ifndef __SIMULATION_HPP__
+#define __SIMULATION_HPP__
+
+#include "scene.hpp"
+#include "triple_buffer.hpp"
+#include "thread_pool.hpp"
+
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+// advances a Scene on its own thread at a fixed rate and publishes each step
+// through a triple buffer.  with a rate of 0 no thread is started and every
+// update() steps the scene inline on the caller's thread instead.  while
+// paused no steps are taken and scene time stands still, picking up where it
+// left off on resume.
+class Simulation {
+private:
+    typedef std::chrono::steady_clock clock;
+
+    Scene const & scene_;
+    std::function<double()> time_;
+    double rate_;
+
+    TripleBuffer<SceneState> states_;
+    ThreadPool pool_;
+
+    std::atomic<bool> running_;
+    std::atomic<bool> paused_;
+    std::atomic<double> paused_time_;  // scene time frozen at the pause
+    std::atomic<double> time_offset_;  // time spent paused, taken off the clock
+    std::atomic<size_t> steps_;
+    std::atomic<long long> step_ns_;
+    std::function<void()> notify_;
+    std::thread thread_;
+
+    void step() {
+        auto start = clock::now();
+
+        scene_.update(time_() - time_offset_, states_.back(), &pool_);
+        states_.publish();
+
+        step_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start).count();
+        steps_++;
+        if(notify_) notify_();
+    }
+
+    void run() {
+        auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1. / rate_));
+        auto next = clock::now();
+
+        while(running_) {
+            if(!paused_) step();
+            next += period;
+            // don't try to catch up after a stall
+            auto now = clock::now();
+            if(next < now) next = now;
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+public:
+    Simulation(Scene const & scene, std::function<double()> time, double rate)
+        : scene_(scene), time_(time), rate_(rate),
+          running_(false), paused_(false), paused_time_(0.), time_offset_(0.), steps_(0), step_ns_(0)
+    { }
+    Simulation(Simulation const &) = delete;
+
+    ~Simulation() { stop(); }
+
+    void start() {
+        if(rate_ <= 0. || running_) return;
+
+        // the reader should never see an empty state
+        step();
+        states_.update();
+
+        running_ = true;
+        thread_ = std::thread(&Simulation::run, this);
+    }
+
+    void stop() {
+        if(!running_) return;
+
+        running_ = false;
+        thread_.join();
+    }
+
+    bool threaded() const { return rate_ > 0.; }
+
+    // called from the simulation thread after every step, e.g. to wake an
+    // event loop that is blocked waiting for input.  set before start()
+    void on_step(std::function<void()> notify) { notify_ = notify; }
+
+    void set_paused(bool paused) {
+        if(paused == paused_) return;
+        if(paused) {
+            paused_time_ = time_() - time_offset_;
+        } else {
+            time_offset_ = time_() - paused_time_;
+        }
+        paused_ = paused;
+    }
+    bool paused() const { return paused_; }
+
+    // picks up the latest published state, returns true if it changed
+    bool update() {
+        if(!threaded() && !paused_) step();
+        return states_.update();
+    }
+    SceneState const & state() const { return states_.front(); }
+
+    size_t steps() const { return steps_; }
+    double mean_step_ms() const {
+        return steps_ == 0 ? 0. : step_ns_ * 1e-6 / steps_;
+    }
+};
+
+#endif
@@ -0,0 +1,300 @@
+#ifndef __STAR_CATALOG_HPP__
+#define __STAR_CATALOG_HPP__
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <glm/vec3.hpp> // glm::vec3
+#include <glm/vec4.hpp> // glm::vec4
+#include <glm/mat4x4.hpp> // glm::mat4
+#include <glm/glm.hpp>  // glm::dot, glm::normalize
+#include <glm/ext/scalar_constants.hpp> // glm::pi
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+// a star catalog laid out to be mapped and read in place.  the sky is split
+// into the cells of a cube sphere, `resolution` x `resolution` per face with
+// the equal angle warp so cells are of similar area, and the stars of each
+// cell are stored together, brightest first:
+//
+//   star_catalog_header
+//   uint32_t cell_start[cells + 1]   first star of each cell, then the total
+//   catalog_star stars[stars]
+//
+// so the stars of one cell down to a magnitude limit are one contiguous run
+// and only the pages of cells in view are ever touched.
+
+static const uint32_t star_catalog_magic = 0x53504c47; // "GLPS"
+static const uint32_t star_catalog_version = 1;
+
+struct star_catalog_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t resolution;
+    uint32_t reserved;
+    uint64_t stars;
+    float brightest;
+    float faintest;
+};
+
+struct catalog_star {
+    float x, y, z;    // unit direction
+    float magnitude;  // visual
+    float color;      // B-V index
+};
+
+class StarCatalog {
+private:
+    int fd_;
+    void * map_;
+    size_t map_size_;
+    star_catalog_header const * header_;
+    uint32_t const * cell_start_;
+    catalog_star const * stars_;
+    // per cell: direction of its centre and the sine of the angle to its
+    // farthest corner
+    std::vector<glm::vec4> cones_;
+
+    // equal angle warp of a face coordinate in [-1, 1]
+    static float warp(float u) { return std::atan(u) * (4.f / glm::pi<float>()); }
+    static float unwarp(float w) { return std::tan(w * (glm::pi<float>() / 4.f)); }
+
+    static glm::vec3 face_direction(uint32_t face, float u, float v) {
+        switch(face) {
+        case 0: return glm::vec3(1.f, v, -u);
+        case 1: return glm::vec3(-1.f, v, u);
+        case 2: return glm::vec3(u, 1.f, -v);
+        case 3: return glm::vec3(u, -1.f, v);
+        case 4: return glm::vec3(u, v, 1.f);
+        default: return glm::vec3(-u, v, -1.f);
+        }
+    }
+
+    void build_cones() {
+        uint32_t n = resolution();
+        cones_.resize(cells());
+        for(uint32_t face = 0; face < 6; face++) {
+            for(uint32_t y = 0; y < n; y++) {
+                for(uint32_t x = 0; x < n; x++) {
+                    auto corner = [&](float cx, float cy) {
+                        return glm::normalize(face_direction(face, unwarp(2.f * cx / n - 1.f), unwarp(2.f * cy / n - 1.f)));
+                    };
+                    glm::vec3 center = corner(x + 0.5f, y + 0.5f);
+                    float min_cos = 1.f;
+                    for(int c = 0; c < 4; c++) {
+                        min_cos = std::min(min_cos, glm::dot(center, corner(float(x + (c & 1)), float(y + (c >> 1)))));
+                    }
+                    float sine = std::sqrt(std::max(0.f, 1.f - min_cos * min_cos));
+                    cones_[(face * n + y) * n + x] = glm::vec4(center, sine);
+                }
+            }
+        }
+    }
+
+public:
+    StarCatalog() : fd_(-1), map_(MAP_FAILED), map_size_(0), header_(nullptr), cell_start_(nullptr), stars_(nullptr) { }
+    StarCatalog(StarCatalog const &) = delete;
+    ~StarCatalog() { close(); }
+
+    static uint32_t cell_of(glm::vec3 d, uint32_t resolution) {
+        glm::vec3 a(std::abs(d.x), std::abs(d.y), std::abs(d.z));
+        uint32_t face;
+        float u, v;
+        if(a.x >= a.y && a.x >= a.z) {
+            face = d.x > 0.f ? 0 : 1;
+            u = (d.x > 0.f ? -d.z : d.z) / a.x;
+            v = d.y / a.x;
+        } else if(a.y >= a.z) {
+            face = d.y > 0.f ? 2 : 3;
+            u = d.x / a.y;
+            v = (d.y > 0.f ? -d.z : d.z) / a.y;
+        } else {
+            face = d.z > 0.f ? 4 : 5;
+            u = (d.z > 0.f ? d.x : -d.x) / a.z;
+            v = d.y / a.z;
+        }
+        auto index = [resolution](float w) {
+            int i = int((warp(w) + 1.f) * 0.5f * resolution);
+            return uint32_t(std::clamp(i, 0, int(resolution) - 1));
+        };
+        return (face * resolution + index(v)) * resolution + index(u);
+    }
+
+    // sorts `stars` into cells and writes them out.  false and a message on failure
+    static bool write(std::string const & path, std::vector<catalog_star> stars, uint32_t resolution) {
+        size_t cells = 6 * size_t(resolution) * resolution;
+        std::vector<uint32_t> cell(stars.size());
+        for(size_t i = 0; i < stars.size(); i++) {
+            cell[i] = cell_of(glm::vec3(stars[i].x, stars[i].y, stars[i].z), resolution);
+        }
+        std::vector<uint32_t> order(stars.size());
+        for(size_t i = 0; i < order.size(); i++) order[i] = uint32_t(i);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            if(cell[a] != cell[b]) return cell[a] < cell[b];
+            return stars[a].magnitude < stars[b].magnitude;
+        });
+
+        std::vector<uint32_t> cell_start(cells + 1, 0);
+        for(uint32_t c : cell) cell_start[c + 1]++;
+        for(size_t c = 0; c < cells; c++) cell_start[c + 1] += cell_start[c];
+
+        star_catalog_header header = { star_catalog_magic, star_catalog_version, resolution, 0, stars.size(), 0.f, 0.f };
+        if(!stars.empty()) {
+            auto range = std::minmax_element(stars.begin(), stars.end(), [](catalog_star const & a, catalog_star const & b) {
+                return a.magnitude < b.magnitude;
+            });
+            header.brightest = range.first->magnitude;
+            header.faintest = range.second->magnitude;
+        }
+
+        std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!out) {
+            std::cerr << "could not open star catalog '" << path << "' for writing\n";
+            return false;
+        }
+        out.write(reinterpret_cast<char const *>(&header), sizeof(header));
+        out.write(reinterpret_cast<char const *>(cell_start.data()), cell_start.size() * sizeof(uint32_t));
+        for(uint32_t i : order) {
+            out.write(reinterpret_cast<char const *>(&stars[i]), sizeof(catalog_star));
+        }
+        if(!out) {
+            std::cerr << "could not write star catalog '" << path << "'\n";
+            return false;
+        }
+        return true;
+    }
+
+    // maps the catalog read-only.  false and a message if it is missing or malformed
+    bool open(std::string const & path) {
+        close();
+
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if(fd_ < 0) {
+            std::cerr << "could not open star catalog '" << path << "': " << strerror(errno) << "\n";
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd_, &st) != 0 || size_t(st.st_size) < sizeof(star_catalog_header)) {
+            std::cerr << "star catalog '" << path << "' is too small\n";
+            close();
+            return false;
+        }
+        map_size_ = st.st_size;
+        map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if(map_ == MAP_FAILED) {
+            std::cerr << "could not map star catalog '" << path << "': " << strerror(errno) << "\n";
+            close();
+            return false;
+        }
+
+        header_ = static_cast<star_catalog_header const *>(map_);
+        size_t cells = 6 * size_t(header_->resolution) * header_->resolution;
+        size_t expected = sizeof(star_catalog_header) + (cells + 1) * sizeof(uint32_t) + header_->stars * sizeof(catalog_star);
+        if(header_->magic != star_catalog_magic || header_->version != star_catalog_version ||
+           header_->resolution == 0 || map_size_ != expected)
+        {
+            std::cerr << "'" << path << "' is not a star catalog this build can read\n";
+            close();
+            return false;
+        }
+
+        cell_start_ = reinterpret_cast<uint32_t const *>(header_ + 1);
+        stars_ = reinterpret_cast<catalog_star const *>(cell_start_ + cells + 1);
+        if(cell_start_[cells] != header_->stars) {
+            std::cerr << "star catalog '" << path << "' has an inconsistent cell table\n";
+            close();
+            return false;
+        }
+        build_cones();
+        return true;
+    }
+
+    void close() {
+        if(map_ != MAP_FAILED) munmap(map_, map_size_);
+        if(fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+        map_ = MAP_FAILED;
+        map_size_ = 0;
+        header_ = nullptr;
+        cell_start_ = nullptr;
+        stars_ = nullptr;
+        cones_.clear();
+    }
+
+    bool is_open() const { return header_ != nullptr; }
+    size_t size() const { return header_ != nullptr ? header_->stars : 0; }
+    uint32_t resolution() const { return header_ != nullptr ? header_->resolution : 0; }
+    size_t cells() const { return 6 * size_t(resolution()) * resolution(); }
+    float faintest() const { return header_ != nullptr ? header_->faintest : 0.f; }
+    size_t bytes() const { return map_size_; }
+
+    // appends every star in view no fainter than `magnitude_limit`: the
+    // direction and magnitude to `xyzm`, the B-V index to `color`.  stars are
+    // at infinity, so only the directions of the four side planes of the
+    // view frustum matter.  returns the number of cells in view
+    size_t query(glm::mat4 const & view_projection, float magnitude_limit,
+                 std::vector<float> & xyzm, std::vector<float> & color) const
+    {
+        return query(&view_projection, 1, magnitude_limit, xyzm, color);
+    }
+
+    // the same for the stars in any of several views, each once
+    size_t query(glm::mat4 const * view_projections, size_t views, float magnitude_limit,
+                 std::vector<float> & xyzm, std::vector<float> & color) const
+    {
+        xyzm.clear();
+        color.clear();
+        if(!is_open()) return 0;
+
+        // Gribb and Hartmann: row 3 plus or minus rows 0 and 1
+        std::vector<glm::vec3> planes(4 * views);
+        for(size_t v = 0; v < views; v++) {
+            glm::mat4 const & view_projection = view_projections[v];
+            for(int p = 0; p < 4; p++) {
+                int row = p >> 1;
+                float sign = (p & 1) ? -1.f : 1.f;
+                glm::vec3 n(view_projection[0][3] + sign * view_projection[0][row],
+                            view_projection[1][3] + sign * view_projection[1][row],
+                            view_projection[2][3] + sign * view_projection[2][row]);
+                planes[4 * v + p] = glm::normalize(n);
+            }
+        }
+
+        size_t visited = 0;
+        for(size_t c = 0; c < cones_.size(); c++) {
+            glm::vec3 center(cones_[c]);
+            bool inside = false;
+            for(size_t v = 0; v < views && !inside; v++) {
+                inside = true;
+                for(int p = 0; p < 4 && inside; p++) {
+                    inside = glm::dot(planes[4 * v + p], center) >= -cones_[c].w;
+                }
+            }
+            if(!inside) continue;
+            visited++;
+
+            catalog_star const * begin = stars_ + cell_start_[c];
+            catalog_star const * end = stars_ + cell_start_[c + 1];
+            end = std::upper_bound(begin, end, magnitude_limit, [](float m, catalog_star const & s) {
+                return m < s.magnitude;
+            });
+            for(catalog_star const * s = begin; s < end; s++) {
+                xyzm.insert(xyzm.end(), { s->x, s->y, s->z, s->magnitude });
+                color.push_back(s->color);
+            }
+        }
+        return visited;
+    }
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef __THREAD_POOL_HPP__
+#define __THREAD_POOL_HPP__
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <latch>
+
+// fixed set of worker threads pulling jobs from a shared FIFO
+class ThreadPool {
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> jobs_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    size_t running_;
+    bool stopping_;
+
+    void work() {
+        for(;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+                if(jobs_.empty()) return;
+
+                job = std::move(jobs_.front());
+                jobs_.pop_front();
+                running_++;
+            }
+
+            job();
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_--;
+            if(running_ == 0 && jobs_.empty()) idle_.notify_all();
+        }
+    }
+
+public:
+    static size_t default_size() {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    ThreadPool(size_t threads = default_size())
+        : running_(0), stopping_(false)
+    {
+        threads = std::max<size_t>(threads, 1);
+        for(size_t i = 0; i < threads; i++) {
+            workers_.emplace_back(&ThreadPool::work, this);
+        }
+    }
+    ThreadPool(ThreadPool const &) = delete;
+
+    // finishes every queued job before joining
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        for(auto & w : workers_) w.join();
+    }
+
+    void submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        wake_.notify_one();
+    }
+
+    // blocks until the queue is empty and no job is running
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this]() { return running_ == 0 && jobs_.empty(); });
+    }
+
+    // drops every job that has not started yet
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.clear();
+        if(running_ == 0) idle_.notify_all();
+    }
+
+    size_t size() const { return workers_.size(); }
+
+    // jobs submitted but not yet picked up by a worker
+    size_t queued() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return jobs_.size();
+    }
+};
+
+// splits [0, count) into chunks of `grain` and runs body(begin, end) on each,
+// using the calling thread for the first chunk.  must not be called from one
+// of the pool's own workers.
+template<typename F>
+void parallel_for(ThreadPool & pool, size_t count, size_t grain, F const & body) {
+    grain = std::max<size_t>(grain, 1);
+    size_t chunks = (count + grain - 1) / grain;
+    if(chunks <= 1) {
+        if(count > 0) body(size_t(0), count);
+        return;
+    }
+
+    std::latch done(chunks - 1);
+    for(size_t c = 1; c < chunks; c++) {
+        pool.submit([&body, &done, c, grain, count]() {
+            body(c * grain, std::min(count, (c + 1) * grain));
+            done.count_down();
+        });
+    }
+    body(size_t(0), grain);
+    done.wait();
+}
+
+#endif
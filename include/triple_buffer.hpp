@@ -0,0 +1,49 @@
+#ifndef __TRIPLE_BUFFER_HPP__
+#define __TRIPLE_BUFFER_HPP__
+
+#include <atomic>
+#include <cstdint>
+
+// single producer, single consumer hand off of the latest value.  the writer
+// fills back() and publishes it, the reader picks up whatever was published
+// most recently.  neither side ever blocks or waits on the other; values the
+// reader never got to are silently replaced.
+template<typename T>
+class TripleBuffer {
+private:
+    static constexpr uint8_t index_mask = 0x3;
+    static constexpr uint8_t fresh_bit = 0x4;
+
+    struct alignas(64) slot { T value; };
+
+    slot slots_[3];
+    // index of the slot in the middle, plus fresh_bit when it holds a value
+    // the reader has not seen
+    alignas(64) std::atomic<uint8_t> middle_;
+    alignas(64) uint8_t back_;
+    alignas(64) uint8_t front_;
+
+public:
+    TripleBuffer() : middle_(1), back_(0), front_(2) { }
+    TripleBuffer(T const & initial) : TripleBuffer() {
+        for(auto & s : slots_) s.value = initial;
+    }
+    TripleBuffer(TripleBuffer const &) = delete;
+
+    // writer side
+    T & back() { return slots_[back_].value; }
+    void publish() {
+        back_ = middle_.exchange(back_ | fresh_bit, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // reader side.  returns true if a new value was swapped into front()
+    bool update() {
+        if((middle_.load(std::memory_order_relaxed) & fresh_bit) == 0) return false;
+
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+    T const & front() const { return slots_[front_].value; }
+};
+
+#endif
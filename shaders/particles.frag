@@ -0,0 +1,14 @@
+precision mediump float;
+
+uniform vec3 particle_color;
+
+varying float coverage;
+varying float light;
+
+void main() {
+  // round points, premultiplied for GL_ONE, GL_ONE_MINUS_SRC_ALPHA.  a
+  // particle in shadow still covers what is behind it
+  vec2 p = gl_PointCoord * 2.0 - 1.0;
+  float alpha = coverage * (1.0 - smoothstep(0.6, 1.0, dot(p, p)));
+  gl_FragColor = vec4(particle_color * light * alpha, alpha);
+}
@@ -0,0 +1,68 @@
+precision highp float;
+
+attribute vec3 particle;
+attribute float particle_size;
+
+#ifdef VIEWS
+// every view's, uploaded together once per state, `view` picks this draw's
+uniform mat4 view_vp[VIEWS];
+uniform vec3 view_camera[VIEWS];
+uniform float view_pixels_per_unit[VIEWS];
+uniform float view;
+#define view_projection view_vp[int(view)]
+#define camera view_camera[int(view)]
+#define pixels_per_unit view_pixels_per_unit[int(view)]
+#else
+uniform mat4 view_projection;
+uniform vec3 camera;
+// projection[1][1] * viewport height / 2
+uniform float pixels_per_unit;
+#endif
+uniform vec3 sun;
+uniform vec3 position[PLANETS];
+uniform float radius[PLANETS];
+
+varying float coverage;
+varying float light;
+
+// true if the segment from `orig` along `dir` for `len` passes through the sphere
+bool blocked(vec3 orig, vec3 dir, float len, vec3 center, float r) {
+  vec3 L = center - orig;
+  float tca = dot(L, dir);
+  if(tca < 0.0 || tca > len + r) return false;
+  float d2 = dot(L, L) - tca * tca;
+  if(d2 > r * r) return false;
+  return tca - sqrt(r * r - d2) < len;
+}
+
+void main() {
+  vec3 to_particle = particle - camera;
+  float dist = length(to_particle);
+  vec3 view_dir = to_particle / dist;
+  vec3 l = normalize(sun);
+
+  // the bodies are ray traced without depth, so hide what they cover here
+  // and darken what sits in their shadow
+  float lit = 1.0;
+  for(int i = 0; i < PLANETS; i++) {
+    if(blocked(camera, view_dir, dist, position[i], radius[i])) {
+      gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+      gl_PointSize = 1.0;
+      coverage = 0.0;
+      light = 0.0;
+      return;
+    }
+    if(blocked(particle, l, 1e4, position[i], radius[i])) lit = 0.0;
+  }
+
+  gl_Position = view_projection * vec4(particle, 1.0);
+
+  // anything under a pixel becomes a one pixel point covering that fraction
+  float pixels = 2.0 * particle_size * pixels_per_unit / dist;
+  gl_PointSize = clamp(pixels, 1.0, 16.0);
+  coverage = min(pixels * pixels, 1.0);
+
+  // lit from behind the rings forward scatter, from the front they reflect
+  float phase = 0.6 + 0.4 * abs(dot(view_dir, l));
+  light = lit * phase;
+}
@@ -2,15 +2,55 @@
 
 precision mediump float;
 
+#ifdef VIEWS
+// the view being drawn's, from the vertex shader, under the names the
+// single view uniforms have
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+varying highp vec3 eye;
+#else
+varying vec3 eye;
+#endif
+varying vec3 eye_pixel_x;
+varying vec3 eye_pixel_y;
+#define camera eye
+#define pixel_x eye_pixel_x
+#define pixel_y eye_pixel_y
+#else
 uniform vec3 camera;
+#endif
+#ifndef STAR_CATALOG
 uniform sampler2D starfield;
+#endif
 uniform sampler2DArray texture;
 uniform sampler2DArray dem;
 uniform sampler2DArray norm;
+#ifdef SEQUENCE
+// the animated map of body SEQUENCE, in whichever layer was uploaded last
+uniform sampler2DArray sequence;
+uniform float sequence_layer;
+#endif
 uniform float radius[PLANETS];
 uniform vec3 position[PLANETS];
+// per body level of detail picked on the CPU from its size on screen:
+// 0 full BRDF with normal map, 1 Lambert with albedo texture, 2 flat colour
+uniform float shading[PLANETS];
+uniform vec3 albedo[PLANETS];
 
 uniform vec3 sun;
+uniform float sun_radius; // angular, radians
+
+// occluder position and radius, and the body it shadows, for each eclipse
+// the CPU found this frame.  only the first shadow_count are valid
+uniform vec4 shadow_occluder[MAX_SHADOWS];
+uniform float shadow_receiver[MAX_SHADOWS];
+uniform float shadow_count;
+
+#ifndef VIEWS
+// how far `direction` moves across one pixel, for the extra rays of the
+// pixels on a limb
+uniform vec3 pixel_x;
+uniform vec3 pixel_y;
+#endif
 
 varying vec3 direction;
 
@@ -34,6 +74,13 @@ vec4 textureSphereArray(sampler2DArray textureArray, vec3 p, int dex) {
     return texture2DArray(textureArray, vec3(s.s + 0.5, s.t + 0.5, dex));
 }
 
+vec3 bodyColor(vec3 n, int body) {
+#ifdef SEQUENCE
+    if(body == SEQUENCE) return textureSphereArray(sequence, n, int(sequence_layer)).rgb;
+#endif
+    return textureSphereArray(texture, n, body).rgb;
+}
+
 void swap(inout float a, inout float b) {
     float c = a;
     a = b;
@@ -108,7 +155,7 @@ float Fd_Burley(float linearRoughness, float NoV, float NoL, float LoH) {
 bool rayIntersectsSphere(
     vec3 orig, vec3 dir, 
     vec3 center, float radius, 
-    out vec3 inter, out vec3 N, out vec3 T, out vec3 B, 
+    out vec3 inter, out vec3 N, 
     out float dist) 
 {
     float r2 = radius * radius;
@@ -132,7 +179,13 @@ bool rayIntersectsSphere(
 
     inter = orig + t0 * dir;
     N = normalize(inter - center);
+    dist = t0;
 
+    return true;
+}
+
+// only the full shading tier needs the tangent frame
+void tangentFrame(vec3 N, out vec3 T, out vec3 B) {
     // texture coords are x == lon, y == lat
 
     // float lat = asin(N.y)
@@ -143,98 +196,374 @@ bool rayIntersectsSphere(
     vec3 n1 = vec3(r * sin(lon), N.y, r * cos(lon));
     T = normalize(n1 - N);
     B = cross(N, T);
-    dist = t0;
-
-    return true;
 }
 
 
-bool intersectsScene(vec3 origin, vec3 direction, out vec3 inter, out vec3 N, out vec3 T, out vec3 B, out vec3 diffuse, out vec3 norm_vector)
+// the per body uniforms are read inside the loop, where they are indexed by
+// the loop counter, as GLSL ES 1.00 fragment shaders require
+bool intersectsScene(vec3 origin, vec3 direction, out vec3 inter, out vec3 N, out int body, out float tier, out vec3 flat_albedo)
 {
     int mindex = -1;
     float min = -1., m;
-    vec3 inter0, N0, T0, B0;
+    vec3 inter0, N0;
     for(int i = 0; i < PLANETS; i++) {
-        if(rayIntersectsSphere(origin, direction, position[i], radius[i], inter0, N0, T0, B0, m)) {
+        if(rayIntersectsSphere(origin, direction, position[i], radius[i], inter0, N0, m)) {
             if(min < 0. || m < min) {
                 min = m;
                 inter = inter0;
                 N = N0;
-                T = T0;
-                B = B0;
                 mindex = i;
+                tier = shading[i];
+                flat_albedo = albedo[i];
             }
         }
     }
 
-    if(mindex < 0) return false;
+    body = mindex;
+    return mindex >= 0;
+}
+
+// fraction of the sun's disc still visible from p past a spherical occluder,
+// from the overlap of the two discs.  angles are in sun radii so the
+// numbers stay in mediump range
+float sunVisibility(vec3 p, vec3 l, vec4 occluder) {
+    vec3 to = occluder.xyz - p;
+    float dist = length(to);
+    vec3 dir = to / dist;
+    float c = dot(dir, l);
+    if(c <= 0.0) return 1.0;
+
+    float r_o = min(asin(min(occluder.w / dist, 1.0)) / sun_radius, 50.0);
+    float d = atan(length(cross(dir, l)), c) / sun_radius;
+
+    if(d >= 1.0 + r_o) return 1.0;
+    if(d <= r_o - 1.0) return 0.0;
+    if(d <= 1.0 - r_o) return 1.0 - r_o * r_o;
+
+    float a = acos(clamp((d * d + 1.0 - r_o * r_o) / (2.0 * d), -1.0, 1.0));
+    float b = acos(clamp((d * d + r_o * r_o - 1.0) / (2.0 * d * r_o), -1.0, 1.0));
+    float k = sqrt(max((r_o + 1.0 - d) * (d + 1.0 - r_o), 0.0)) * sqrt((d + r_o - 1.0) * (d + r_o + 1.0));
+    float overlap = a + r_o * r_o * b - 0.5 * k;
+    return saturate(1.0 - overlap / PI);
+}
+
+#ifdef ATMOSPHERE
+// precomputed scattering, see atmosphere.hpp.  everything here is in planet
+// radii relative to the planet centre, the ground is at r = 1
+uniform sampler2D transmittance;
+uniform sampler2DArray scattering;
+
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#endif
+
+float atmosphereCoord(float x, float size) {
+    return 0.5 / size + x * (1.0 - 1.0 / size);
+}
+
+float distanceToTop(float r, float mu) {
+    return max(-r * mu + sqrt(max(r * r * (mu * mu - 1.0) + ATMOSPHERE_TOP_RADIUS * ATMOSPHERE_TOP_RADIUS, 0.0)), 0.0);
+}
+
+bool intersectsGround(float r, float mu) {
+    return mu < 0.0 && r * r * (mu * mu - 1.0) + 1.0 >= 0.0;
+}
+
+vec3 transmittanceToTop(float r, float mu) {
+    float rho = sqrt(max(r * r - 1.0, 0.0));
+    float d = distanceToTop(r, mu);
+    float d_min = ATMOSPHERE_TOP_RADIUS - r;
+    float d_max = rho + ATMOSPHERE_H;
+    vec2 uv = vec2(atmosphereCoord((d - d_min) / (d_max - d_min), ATMOSPHERE_TRANSMITTANCE_SIZE.x),
+                   atmosphereCoord(rho / ATMOSPHERE_H, ATMOSPHERE_TRANSMITTANCE_SIZE.y));
+    return texture2D(transmittance, uv).rgb;
+}
+
+// between the point at r, mu and the point d further along the ray
+vec3 transmittanceAlong(float r, float mu, float d, bool ground) {
+    float r_d = clamp(sqrt(d * d + 2.0 * r * mu * d + r * r), 1.0, ATMOSPHERE_TOP_RADIUS);
+    float mu_d = clamp((r * mu + d) / r_d, -1.0, 1.0);
+    if(ground) {
+        return min(transmittanceToTop(r_d, -mu_d) / transmittanceToTop(r, -mu), vec3(1.0));
+    }
+    return min(transmittanceToTop(r, mu) / transmittanceToTop(r_d, mu_d), vec3(1.0));
+}
+
+vec3 transmittanceToSun(float r, float mu_s) {
+    float sin_h = 1.0 / r;
+    float cos_h = -sqrt(max(1.0 - sin_h * sin_h, 0.0));
+    float e = sin_h * ATMOSPHERE_SUN_ANGULAR_RADIUS;
+    return transmittanceToTop(r, mu_s) * smoothstep(-e, e, mu_s - cos_h);
+}
 
-    norm_vector = normalize(textureSphereArray(norm, N, mindex).xyz * 0.5 - 0.5);
-    diffuse = textureSphereArray(texture, N, mindex).rgb;
+// the 4D table is stored as one layer per r, with nu and mu_s side by side
+// in x.  interpolates nu and r by hand: 4 fetches
+vec4 scatteringLookup(float r, float mu, float mu_s, float nu, bool ground) {
+    vec4 size = ATMOSPHERE_SCATTERING_SIZE; // nu, mu_s, mu, r
+    float H = ATMOSPHERE_H;
+    float rho = sqrt(max(r * r - 1.0, 0.0));
+    float u_r = atmosphereCoord(rho / H, size.w);
+
+    float r_mu = r * mu;
+    float discriminant = r_mu * r_mu - r * r + 1.0;
+    float u_mu;
+    if(ground) {
+        float d = -r_mu - sqrt(max(discriminant, 0.0));
+        float d_min = r - 1.0;
+        float d_max = rho;
+        u_mu = 0.5 - 0.5 * atmosphereCoord(d_max == d_min ? 0.0 : (d - d_min) / (d_max - d_min), size.z / 2.0);
+    } else {
+        float d = -r_mu + sqrt(max(discriminant + H * H, 0.0));
+        float d_min = ATMOSPHERE_TOP_RADIUS - r;
+        float d_max = rho + H;
+        u_mu = 0.5 + 0.5 * atmosphereCoord((d - d_min) / (d_max - d_min), size.z / 2.0);
+    }
+
+    float d_min = ATMOSPHERE_TOP_RADIUS - 1.0;
+    float a = (distanceToTop(1.0, mu_s) - d_min) / (H - d_min);
+    float A = (distanceToTop(1.0, ATMOSPHERE_MU_S_MIN) - d_min) / (H - d_min);
+    float u_mu_s = atmosphereCoord(max(1.0 - a / A, 0.0) / (1.0 + a), size.y);
+
+    float x = (nu + 1.0) / 2.0 * (size.x - 1.0);
+    float x0 = floor(x);
+    float lerp_nu = x - x0;
+    float z = clamp(u_r * size.w - 0.5, 0.0, size.w - 1.0);
+    float z0 = floor(z);
+    float z1 = min(z0 + 1.0, size.w - 1.0);
+
+    vec2 uv0 = vec2((x0 + u_mu_s) / size.x, u_mu);
+    vec2 uv1 = vec2((x0 + 1.0 + u_mu_s) / size.x, u_mu);
+    vec4 s0 = mix(texture2DArray(scattering, vec3(uv0, z0)), texture2DArray(scattering, vec3(uv1, z0)), lerp_nu);
+    vec4 s1 = mix(texture2DArray(scattering, vec3(uv0, z1)), texture2DArray(scattering, vec3(uv1, z1)), lerp_nu);
+    return mix(s0, s1, z - z0);
+}
+
+// rayleigh and multiple scattering are in rgb, single mie scattering is
+// extrapolated from its red channel in alpha
+vec3 atmosphereRadiance(vec4 s, float nu) {
+    vec3 mie = s.r > 0.0 ? s.rgb * (s.a / s.r) * (ATMOSPHERE_RAYLEIGH.r / ATMOSPHERE_RAYLEIGH) : vec3(0.0);
+    float g = ATMOSPHERE_MIE_G;
+    float rayleigh_phase = 3.0 / (16.0 * PI) * (1.0 + nu * nu);
+    float mie_phase = 3.0 / (8.0 * PI) * (1.0 - g * g) / (2.0 + g * g) * (1.0 + nu * nu) / pow(1.0 + g * g - 2.0 * g * nu, 1.5);
+    return s.rgb * rayleigh_phase + mie * mie_phase;
+}
+
+// moves a camera outside the atmosphere to where the ray enters it
+bool enterAtmosphere(inout vec3 origin, vec3 view, out float r, out float rmu) {
+    r = length(origin);
+    rmu = dot(origin, view);
+    float to_top = -rmu - sqrt(max(rmu * rmu - r * r + ATMOSPHERE_TOP_RADIUS * ATMOSPHERE_TOP_RADIUS, 0.0));
+    if(to_top > 0.0) {
+        origin += view * to_top;
+        r = ATMOSPHERE_TOP_RADIUS;
+        rmu += to_top;
+    } else if(r > ATMOSPHERE_TOP_RADIUS) {
+        return false;
+    }
     return true;
 }
 
+// light scattered towards the camera along a ray that leaves the atmosphere
+vec3 skyRadiance(vec3 origin, vec3 view, vec3 sun_direction, out vec3 view_transmittance) {
+    float r, rmu;
+    view_transmittance = vec3(1.0);
+    if(!enterAtmosphere(origin, view, r, rmu)) return vec3(0.0);
+
+    float mu = rmu / r;
+    float mu_s = dot(origin, sun_direction) / r;
+    float nu = dot(view, sun_direction);
+    bool ground = intersectsGround(r, mu);
+
+    view_transmittance = ground ? vec3(0.0) : transmittanceToTop(r, mu);
+    return atmosphereRadiance(scatteringLookup(r, mu, mu_s, nu, ground), nu);
+}
+
+// the same for a ray that ends at `point`
+vec3 skyRadianceToPoint(vec3 origin, vec3 point, vec3 sun_direction, out vec3 view_transmittance) {
+    vec3 view = normalize(point - origin);
+    float r, rmu;
+    view_transmittance = vec3(1.0);
+    if(!enterAtmosphere(origin, view, r, rmu)) return vec3(0.0);
+
+    float mu = rmu / r;
+    float mu_s = dot(origin, sun_direction) / r;
+    float nu = dot(view, sun_direction);
+    float d = length(point - origin);
+    bool ground = intersectsGround(r, mu);
+
+    view_transmittance = transmittanceAlong(r, mu, d, ground);
+
+    float r_p = clamp(sqrt(d * d + 2.0 * r * mu * d + r * r), 1.0, ATMOSPHERE_TOP_RADIUS);
+    float mu_p = (r * mu + d) / r_p;
+    float mu_s_p = (r * mu_s + d * nu) / r_p;
+
+    vec4 s = scatteringLookup(r, mu, mu_s, nu, ground);
+    vec4 s_p = scatteringLookup(r_p, mu_p, mu_s_p, nu, ground);
+    vec4 inscatter = max(s - vec4(view_transmittance, view_transmittance.r) * s_p, vec4(0.0));
+    return atmosphereRadiance(inscatter, nu);
+}
+
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision mediump float;
+#endif
+#endif
+
 // float Fd_Lambert() {
 //     return 1.0 / PI;
 // }
 
-void main() {
+// radiance along the unit ray d from the camera
+vec3 shade(vec3 d) {
 
     vec3 inter = vec3(0.,0.,0.);
     vec3 n = vec3(0., 0., 0.);
     vec3 b, t;
     vec3 center = vec3(0., 0., 0.);
-    vec3 d = normalize(direction);
 
     vec3 v = -d;
     vec3 l = normalize(sun);
     vec3 h = normalize(v + l);
-    vec3 r = normalize(reflect(direction, n));
+    vec3 r = normalize(reflect(d, n));
 
     float metallic = 0.2;
     float roughness = 0.5;
     float intensity = 2.0;
 
     vec3 nm, baseColor;
+    int body;
+    float tier;
+    vec3 flatAlbedo;
 
 
     float linearRoughness = roughness * roughness;
 
-    if(intersectsScene(camera, d, inter, n, t, b, baseColor, nm)) {
-        // mat3 tbn = mat3(t.x, b.x, n.x, t.y, b.y, n.y, t.z, b.z, n.z);
-        mat3 tbn = mat3(t.x, t.y, t.z, b.x, b.y, b.z, n.x, n.y, n.z);
-        // tbn = transpose(tbn);
+    if(intersectsScene(camera, d, inter, n, body, tier, flatAlbedo)) {
+        // eclipses by whichever bodies the CPU found in line with the sun
+        float attenuation = 1.0;
+        for(int i = 0; i < MAX_SHADOWS; i++) {
+            if(float(i) >= shadow_count) break;
+            if(shadow_receiver[i] == float(body)) {
+                attenuation *= sunVisibility(inter, l, shadow_occluder[i]);
+            }
+        }
 
-        vec3 light_n = normalize(n + 0.5 * tbn * nm);
+        vec3 color;
+        float NoL;
+        if(tier < 0.5) {
+            tangentFrame(n, t, b);
+            nm = normalize(textureSphereArray(norm, n, body).xyz * 0.5 - 0.5);
+            baseColor = bodyColor(n, body);
 
-        float NoV = abs(dot(light_n, v)) + 1e-5;
-        float NoL = saturate(dot(light_n, l));
-        float NoH = saturate(dot(light_n, h));
-        float LoH = saturate(dot(l, h));
+            // mat3 tbn = mat3(t.x, b.x, n.x, t.y, b.y, n.y, t.z, b.z, n.z);
+            mat3 tbn = mat3(t.x, t.y, t.z, b.x, b.y, b.z, n.x, n.y, n.z);
+            // tbn = transpose(tbn);
 
-        vec3 diffuseColor = (1.0 - metallic) * baseColor.rgb;
-        vec3 f0 = 0.04 * (1.0 - metallic) + baseColor.rgb * metallic;
+            vec3 light_n = normalize(n + 0.5 * tbn * nm);
 
-        //TODO: add shadows
-        // float attenuation = shadow(vec3(0,0,0), l);
-        float attenuation = 1.0;
+            float NoV = abs(dot(light_n, v)) + 1e-5;
+            NoL = saturate(dot(light_n, l));
+            float NoH = saturate(dot(light_n, h));
+            float LoH = saturate(dot(l, h));
+
+            vec3 diffuseColor = (1.0 - metallic) * baseColor.rgb;
+            vec3 f0 = 0.04 * (1.0 - metallic) + baseColor.rgb * metallic;
 
-        // specular BRDF
-        float D = D_GGX(linearRoughness, NoH, h);
-        float V = V_SmithGGXCorrelated(linearRoughness, NoV, NoL);
-        vec3  F = F_Schlick(f0, LoH);
-        vec3 Fr = (D * V) * F;
-        // diffuse BRDF
-        vec3 Fd = diffuseColor * Fd_Burley(linearRoughness, NoV, NoL, LoH);
+            // specular BRDF
+            float D = D_GGX(linearRoughness, NoH, h);
+            float V = V_SmithGGXCorrelated(linearRoughness, NoV, NoL);
+            vec3  F = F_Schlick(f0, LoH);
+            vec3 Fr = (D * V) * F;
+            // diffuse BRDF
+            vec3 Fd = diffuseColor * Fd_Burley(linearRoughness, NoV, NoL, LoH);
+
+            color = Fd + Fr;
+        } else {
+            // a few pixels across: no normal map and no specular, and below
+            // that not even a texture fetch
+            baseColor = tier < 1.5 ? bodyColor(n, body) : flatAlbedo;
+            NoL = saturate(dot(n, l));
+            color = (1.0 - metallic) * baseColor * (1.0 / PI);
+        }
 
-        vec3 color = Fd + Fr;
         // color *= intensity;
         color *= (intensity * attenuation * NoL) * vec3(0.98, 0.92, 0.89);
 
-        gl_FragColor = vec4(color.rgb, 1.0);
-        return;
+#ifdef ATMOSPHERE
+        if(body == ATMOSPHERE_BODY) {
+            // sunlight dimmed on the way down, then the haze between the camera and the cloud tops
+            vec3 planet = position[ATMOSPHERE_BODY];
+            float scale = 1.0 / radius[ATMOSPHERE_BODY];
+            vec3 view_transmittance;
+            vec3 inscatter = skyRadianceToPoint((camera - planet) * scale, (inter - planet) * scale, l, view_transmittance);
+            color = color * transmittanceToSun(1.0, dot(n, l)) * view_transmittance +
+                    inscatter * intensity * vec3(0.98, 0.92, 0.89);
+        }
+#endif
+
+        return color;
+    }
+
+#ifdef STAR_CATALOG
+    // catalog stars are drawn over this as points
+    vec3 background = vec3(0.0);
+#else
+    vec3 background = textureSphere(starfield, d).rgb; 
+#endif
+
+#ifdef ATMOSPHERE
+    // stars seen through the limb, and the limb glow itself
+    vec3 planet = position[ATMOSPHERE_BODY];
+    float scale = 1.0 / radius[ATMOSPHERE_BODY];
+    vec3 sky_transmittance;
+    vec3 sky = skyRadiance((camera - planet) * scale, d, l, sky_transmittance);
+    background = background * sky_transmittance + sky * intensity * vec3(0.98, 0.92, 0.89);
+#endif
+
+    return background;
+}
+
+#ifdef AA_SAMPLES
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#endif
+
+// whether the unit ray d passes within a pixel of the silhouette of any body
+// in front of the camera.  the distance of the ray from each centre against
+// the radius, in pixels at the distance of the centre
+bool nearLimb(vec3 d) {
+    float footprint = length(pixel_x) / length(direction);
+    for(int i = 0; i < PLANETS; i++) {
+        vec3 L = position[i] - camera;
+        float along = dot(L, d);
+        if(along > 0.0 && dot(L, L) > radius[i] * radius[i]) {
+            float miss = length(cross(L, d)) - radius[i];
+            if(abs(miss) < along * footprint) return true;
+        }
     }
+    return false;
+}
+
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision mediump float;
+#endif
+#endif
 
-    gl_FragColor = textureSphere(starfield, d); 
+void main() {
+    vec3 d = normalize(direction);
+
+#ifdef AA_SAMPLES
+    // only the pixels a silhouette passes through get more than one ray,
+    // spread over the pixel along the R2 sequence
+    if(nearLimb(d)) {
+        vec3 sum = vec3(0.0);
+        for(int i = 0; i < AA_SAMPLES; i++) {
+            vec2 offset = fract(vec2(0.5) + float(i) * vec2(0.7548776662, 0.5698402910)) - 0.5;
+            sum += shade(normalize(direction + offset.x * pixel_x + offset.y * pixel_y));
+        }
+        gl_FragColor = vec4(sum / float(AA_SAMPLES), 1.0);
+        return;
+    }
+#endif
 
+    gl_FragColor = vec4(shade(d), 1.0);
 }
\ No newline at end of file
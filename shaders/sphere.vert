@@ -1,11 +1,34 @@
 precision mediump float;
 
 attribute vec2 corner;
+#ifdef VIEWS
+// every view's transform, camera and pixel steps, uploaded together once per
+// state.  `view` picks this draw's, and the fragment shader gets the rest as
+// varyings that are the same at every corner
+uniform mat4 view_inv[VIEWS];
+uniform highp vec3 view_camera[VIEWS];
+uniform vec3 view_pixel_x[VIEWS];
+uniform vec3 view_pixel_y[VIEWS];
+uniform float view;
+
+varying highp vec3 eye;
+varying vec3 eye_pixel_x;
+varying vec3 eye_pixel_y;
+#else
 uniform mat4 inv;
+#endif
 
 varying vec3 direction;
 
 void main() {
   gl_Position = vec4(corner, 1.0, 1.0);
+#ifdef VIEWS
+  int v = int(view);
+  direction = (view_inv[v] * gl_Position).xyz;
+  eye = view_camera[v];
+  eye_pixel_x = view_pixel_x[v];
+  eye_pixel_y = view_pixel_y[v];
+#else
   direction = (inv * gl_Position).xyz;
+#endif
 }
\ No newline at end of file
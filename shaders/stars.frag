@@ -0,0 +1,8 @@
+precision mediump float;
+
+varying vec3 color;
+
+void main() {
+  vec2 p = gl_PointCoord * 2.0 - 1.0;
+  gl_FragColor = vec4(color * exp(-3.0 * dot(p, p)), 1.0);
+}
@@ -0,0 +1,51 @@
+precision highp float;
+
+attribute vec4 star;        // direction, visual magnitude
+attribute float star_color; // B-V index
+
+#ifdef VIEWS
+// every view's, uploaded together once per state, `view` picks this draw's
+uniform mat4 view_vp[VIEWS];
+uniform vec3 view_camera[VIEWS];
+uniform float view;
+#define view_projection view_vp[int(view)]
+#define camera view_camera[int(view)]
+#else
+uniform mat4 view_projection;
+uniform vec3 camera;
+#endif
+uniform vec3 position[PLANETS];
+uniform float radius[PLANETS];
+uniform float magnitude_limit;
+
+varying vec3 color;
+
+// rough colour of a star from its B-V index, blue-white to orange
+vec3 bvColor(float bv) {
+  float t = clamp((bv + 0.3) / 2.0, 0.0, 1.0);
+  return mix(vec3(0.64, 0.75, 1.0), vec3(1.0, 0.62, 0.32), t) + vec3(0.15) * (1.0 - abs(2.0 * t - 1.0));
+}
+
+void main() {
+  // the bodies are ray traced without depth, so hide the stars they cover
+  for(int i = 0; i < PLANETS; i++) {
+    vec3 L = position[i] - camera;
+    float tca = dot(L, star.xyz);
+    if(tca > 0.0 && dot(L, L) - tca * tca < radius[i] * radius[i]) {
+      gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+      gl_PointSize = 1.0;
+      color = vec3(0.0);
+      return;
+    }
+  }
+
+  // at infinity, so the view translation drops out.  kept just inside the far plane
+  gl_Position = view_projection * vec4(star.xyz, 0.0);
+  gl_Position.z = gl_Position.w * 0.99999;
+
+  // a star at the limit is barely there, brighter ones grow rather than saturate
+  float intensity = 0.04 * pow(10.0, 0.4 * (magnitude_limit - star.w));
+  float size = clamp(sqrt(intensity) * 2.0, 1.0, 8.0);
+  gl_PointSize = size;
+  color = bvColor(star_color) * min(intensity * 4.0 / (size * size), 1.0);
+}
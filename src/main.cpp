@@ -7,6 +7,13 @@
 #include <tuple>
 #include <memory>
 #include <map>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <chrono>
+
+#include <sys/resource.h>
 
 using std::cout;
 using std::cerr;
@@ -20,6 +27,18 @@ using std::shared_ptr;
 using std::map;
 
 #include "gl.hpp"
+#include "scene.hpp"
+#include "simulation.hpp"
+#include "frame_capture.hpp"
+#include "frame_encoder.hpp"
+#include "shm_ring.hpp"
+#include "atmosphere.hpp"
+#include "particles.hpp"
+#include "star_catalog.hpp"
+#include "sequence.hpp"
+#ifdef DEBUG
+#include "debug_messages.hpp"
+#endif
 
 #include <boost/program_options.hpp>
 using namespace boost::program_options;
@@ -60,20 +79,24 @@ std::vector<std::string> GetFirstNMessages(GLuint numMsgs = 100)
 void error_callback(int error, const char * desc) {
 	cerr << "ERROR: " << desc << "\n";
 }
-void GLAPIENTRY
-MessageCallback( GLenum source,
-                 GLenum type,
-                 GLuint id,
-                 GLenum severity,
-                 GLsizei length,
-                 const GLchar* message,
-                 const void* userParam )
-{
-  fprintf( stderr, "GL CALLBACK: %s type = 0x%x, severity = 0x%x, message = %s\n",
-           ( type == GL_DEBUG_TYPE_ERROR ? "** GL ERROR **" : "" ),
-            type, severity, message );
-}
 
+// set by the window callbacks below, handled by the render loop
+struct WindowEvents {
+	bool damaged = true;      // contents lost or resized, redraw whatever changed
+	bool toggle_pause = false;
+};
+
+void window_damaged_callback(GLFWwindow * window) {
+	static_cast<WindowEvents *>(glfwGetWindowUserPointer(window))->damaged = true;
+}
+void framebuffer_size_callback(GLFWwindow * window, int, int) {
+	window_damaged_callback(window);
+}
+void key_callback(GLFWwindow * window, int key, int, int action, int) {
+	if(key == GLFW_KEY_SPACE && action == GLFW_PRESS) {
+		static_cast<WindowEvents *>(glfwGetWindowUserPointer(window))->toggle_pause = true;
+	}
+}
 
 struct Transform {
     glm::mat4 m;
@@ -81,22 +104,6 @@ struct Transform {
 };
 
 
-class Orbit {
-private:
-    float radius_;
-    glm::mat4 translate_;
-
-public:
-    Orbit(float radius) : radius_(radius) {
-        translate_ = glm::translate(glm::identity<glm::mat4>(), glm::vec3(radius, 0.0f, 0.0f));    
-    }
-
-    glm::mat4 operator()(float distance) const {
-        return glm::rotate(translate_, glm::radians(distance / radius_), glm::vec3(0.0f, 0.0f, 1.0f));
-    }
-};
-
-
 #if 0
 
 
@@ -182,14 +189,150 @@ public:
 #endif
 
 
+struct OfflineSettings {
+	string directory;
+	double start, end, step;
+	int width, height;
+	FrameEncoder::format format;
+	size_t encoders;
+};
+
+// an extra view, in fractions of the frame from its bottom left corner
+struct ViewSpec {
+	glm::vec4 rect;
+	int follow;     // body the camera circles, -1 for the scene origin
+	float distance;
+	float fov;      // radians
+};
+
+// "x,y,width,height[,body[,distance[,fov]]]", the field of view in degrees
+bool parse_view(string const & text, Scene const & scene, float fov, ViewSpec & spec) {
+	std::vector<string> fields;
+	std::stringstream stream(text);
+	for(string field; std::getline(stream, field, ',');) fields.push_back(field);
+
+	spec = { glm::vec4(0.f), -1, 10.f, fov };
+	try {
+		if(fields.size() < 4 || fields.size() > 7) throw std::invalid_argument(text);
+		for(int i = 0; i < 4; i++) spec.rect[i] = std::stof(fields[i]);
+		if(fields.size() > 5) spec.distance = std::stof(fields[5]);
+		if(fields.size() > 6) spec.fov = std::stof(fields[6]) * glm::pi<float>() / 180.f;
+	} catch(std::exception const &) {
+		cerr << "invalid view '" << text << "', expected x,y,width,height[,body[,distance[,fov]]]\n";
+		return false;
+	}
+	if(fields.size() > 4) {
+		for(size_t i = 0; i < scene.size(); i++) {
+			if(scene.bodies()[i].name == fields[4]) spec.follow = (int)i;
+		}
+		if(spec.follow < 0) {
+			cerr << "no body '" << fields[4] << "' for view '" << text << "'\n";
+			return false;
+		}
+	}
+	if(spec.rect.z <= 0.f || spec.rect.w <= 0.f || spec.distance <= 0.f || spec.fov <= 0.f) {
+		cerr << "invalid view '" << text << "'\n";
+		return false;
+	}
+	return true;
+}
+
+// renders [start, end] at a fixed timestep into an offscreen target as fast as
+// the GPU allows, reading frames back asynchronously and encoding them on a
+// worker pool
+bool render_offline(OfflineSettings const & settings, Scene & scene, 
+                    std::function<void(SceneState const &)> draw, 
+                    glm::mat4 const & projection)
+{
+	Framebuffer target(settings.width, settings.height);
+	PixelReader reader(settings.width, settings.height);
+	FrameEncoder encoder(settings.directory, settings.format, settings.encoders, 2 * settings.encoders);
+
+	auto to_encoder = [&encoder](uint64_t frame, unsigned char const * rgba, int width, int height) {
+		encoder.submit(frame, rgba, width, height);
+	};
+
+	scene.set_projection(projection);
+	scene.set_viewport_height((float)settings.height);
+	// steps that divide the range exactly land a hair under a whole number, e.g. 10 / 0.1
+	size_t frame_count = (size_t)std::floor((settings.end - settings.start) / settings.step + 1e-9) + 1;
+	SceneState state;
+
+	double started = glfwGetTime();
+	target.bind();
+	for(size_t frame = 0; frame < frame_count && !encoder.failed(); frame++) {
+		scene.update(settings.start + frame * settings.step, state);
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		GL_TRACE(clear, GLbitfield(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+		draw(state);
+
+		reader.read(frame, to_encoder);
+		reader.collect(to_encoder);
+		GL_TRACE(frame_end);
+	}
+	reader.flush(to_encoder);
+	Framebuffer::unbind();
+
+	double rendered = glfwGetTime();
+	encoder.finish();
+	double finished = glfwGetTime();
+
+	if(encoder.failed()) {
+		cerr << "unable to write frames to '" << settings.directory << "'\n";
+		return false;
+	}
+
+	printf("%zu frames %dx%d rendered in %gs, encoded in %gs = %.1f frames/s\n",
+	    encoder.submitted(), settings.width, settings.height,
+	    rendered - started, finished - started,
+	    encoder.submitted() / (finished - started));
+	printf("encoder queue depth mean %.2f, max %zu of %zu (%zu threads), render stalled %zu times\n",
+	    encoder.mean_queue_depth(), encoder.max_queue_depth(), 2 * settings.encoders,
+	    encoder.threads(), encoder.stalls());
+	return true;
+}
+
 int main(int ac, char * av[]) {
+	// time to first frame counts from here, window and context creation included
+	auto started = std::chrono::steady_clock::now();
+
 	string vertex_shader = "../shaders/sphere.vert";
 	string fragment_shader = "../shaders/sphere.frag";
+	string particle_vertex_shader = "../shaders/particles.vert";
+	string particle_fragment_shader = "../shaders/particles.frag";
+	string star_vertex_shader = "../shaders/stars.vert";
+	string star_fragment_shader = "../shaders/stars.frag";
 	string texture_path = "../img/io-2.jpg";
 	string starfield_path = "../img/TychoSkymapII.t3_04096x02048.jpg";
     string dem_path = "../img/io_dem_4096x2048.png";
     string normal_path = "../img/io_normal_4096x2048.jpg";
 	float fieldOfView = 75., near = 45., far = 1000.;
+	bool sync_load = false;
+	double sim_rate = 240.;
+	OfflineSettings offline = { "", 0., 60., 1. / 30., 1920, 1080, FrameEncoder::png, ThreadPool::default_size() };
+	string offline_format = "png";
+	string shm_name;
+	uint32_t shm_slots = 3;
+	bool no_state_cache = false;
+	string trace_path;
+	size_t trace_frames = 100;
+	bool no_atmosphere = false;
+	float sun_radius_degrees = 1.15f;
+	string atmosphere_cache = "../cache";
+	float lod_full = 24.f, lod_flat = 4.f;
+	bool no_lod = false;
+	size_t moons = 0;
+	size_t ring_particles = 0;
+	string star_catalog_path;
+	float star_magnitude = 6.5f;
+	int aa_samples = 8;
+	string sequence_directory;
+	double sequence_rate = 10.;
+	size_t sequence_ahead = 8;
+	size_t sequence_threads = 2;
+	bool lazy = false;
+	std::vector<string> view_options;
 
 	options_description desc("options");
 	desc.add_options()
@@ -201,6 +344,43 @@ int main(int ac, char * av[]) {
 		("starfield,s", value(&starfield_path), "path to starfield spheremap")
         ("dem_path", value(&dem_path), "path to DEM")
         ("normal_path", value(&normal_path), "path to normal map")
+		("sync-load", bool_switch(&sync_load), "load every texture before the first frame")
+		("sim-rate", value(&sim_rate), "simulation steps per second on its own thread, 0 to step once per frame on the render thread")
+		("lazy", bool_switch(&lazy), "draw only when something on screen changed and sleep until then, space pauses")
+		("render-dir", value(&offline.directory), "render frames offscreen into this directory instead of opening a window")
+		("render-start", value(&offline.start), "scene time of the first rendered frame in seconds")
+		("render-end", value(&offline.end), "scene time of the last rendered frame in seconds")
+		("render-step", value(&offline.step), "scene time between rendered frames in seconds")
+		("render-width", value(&offline.width), "width of rendered frames")
+		("render-height", value(&offline.height), "height of rendered frames")
+		("render-format", value(&offline_format), "png, or yuv for a single raw I420 stream")
+		("encoders", value(&offline.encoders), "frame encoder threads")
+		("shm-output", value(&shm_name), "publish every frame into this POSIX shared memory ring, e.g. /gl_planets")
+		("shm-slots", value(&shm_slots), "frames held by the shared memory ring")
+		("no-state-cache", bool_switch(&no_state_cache), "issue every bind and program switch, even redundant ones")
+		("trace", value(&trace_path), "record the GL calls of the first frames into this file, for gl_planets_replay")
+		("trace-frames", value(&trace_frames), "frames to record with --trace")
+		("no-atmosphere", bool_switch(&no_atmosphere), "draw jupiter without its atmosphere")
+		("sun-radius", value(&sun_radius_degrees), "angular radius of the sun in degrees, sets how soft eclipse shadows are")
+		("atmosphere-cache", value(&atmosphere_cache), "directory the precomputed atmosphere tables are kept in")
+		("lod-full", value(&lod_full), "bodies at least this many pixels in radius get the full BRDF and normal map")
+		("lod-flat", value(&lod_flat), "bodies under this many pixels in radius get a flat colour, Lambert shading in between")
+		("no-lod", bool_switch(&no_lod), "shade every body at full detail whatever its size")
+		("aa", value(&aa_samples), "rays for each pixel a planet's limb passes through, 1 for no anti-aliasing")
+		("moons", value(&moons), "small moons to add around jupiter, each takes uniform space so a few dozen at most")
+		("ring-particles", value(&ring_particles), "particles in jupiter's ring, 0 for none")
+		("particle-vertex", value(&particle_vertex_shader), "particle vertex shader path")
+		("particle-fragment", value(&particle_fragment_shader), "particle fragment shader path")
+		("star-catalog", value(&star_catalog_path), "draw the stars of this catalog, made by gl_planets_star_convert, instead of the starfield image")
+		("star-magnitude", value(&star_magnitude), "faintest catalog stars drawn at a 75 degree field of view, narrower views reach fainter")
+		("star-vertex", value(&star_vertex_shader), "star vertex shader path")
+		("star-fragment", value(&star_fragment_shader), "star fragment shader path")
+		("sequence", value(&sequence_directory), "animate jupiter with the images in this directory, played in name order")
+		("sequence-rate", value(&sequence_rate), "sequence frames per second of scene time")
+		("sequence-ahead", value(&sequence_ahead), "sequence frames decoded ahead of playback, which bounds its memory")
+		("sequence-threads", value(&sequence_threads), "threads decoding sequence frames")
+		("view", value(&view_options)->composing(), "another view drawn over the main one from the same state, as x,y,width,height[,body[,distance[,fov]]] "
+		                                             "in fractions of the frame from its bottom left, circling the named body or the origin. repeatable")
 	;
 	variables_map vm;
 	store(parse_command_line(ac, av, desc), vm);
@@ -212,15 +392,60 @@ int main(int ac, char * av[]) {
 
     notify(vm);
 
+	bool offscreen = !offline.directory.empty();
+	if(offscreen) {
+		if(!FrameEncoder::parse_format(offline_format, offline.format)) {
+			cerr << "unknown render format '" << offline_format << "'\n";
+			return -1;
+		}
+		if(offline.step <= 0. || offline.end < offline.start || offline.width <= 0 || offline.height <= 0) {
+			cerr << "invalid render range or size\n";
+			return -1;
+		}
+		// every frame has to be at full quality
+		sync_load = true;
+	}
 
 	// convert to radians
 	fieldOfView *= glm::pi<float>() / 180.;
+	float sun_radius = sun_radius_degrees * glm::pi<float>() / 180.;
 
 	size_t n_frames;
 	double time_of_first_swap;
 	double time_of_last_swap;
 	double time_now;
 
+	// the projection is filled in once the window size is known
+	Scene scene(glm::identity<glm::mat4>());
+	scene.set_sun_angular_radius(sun_radius);
+	size_t jupiter = scene.add({ "jupiter", 35. /* km */, Orbit(50.), -1 });
+	scene.add({ "io", 5. /* km */, Orbit(0.), -1 });
+
+	// the same every run so frame times can be compared
+	std::mt19937 moon_rng(7);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	for(size_t i = 0; i < moons; i++) {
+		float distance = 45.f + 80.f * unit(moon_rng);
+		double period = 20. + 180. * unit(moon_rng);
+		float phase = 2.f * glm::pi<float>() * unit(moon_rng);
+		scene.add({ "moon " + std::to_string(i), 0.3f + 1.7f * unit(moon_rng), Orbit(distance, period, phase), (int)jupiter });
+	}
+
+	// extra views share the programs, textures and scene update of the main one
+	std::vector<ViewSpec> view_specs(view_options.size());
+	for(size_t v = 0; v < view_options.size(); v++) {
+		if(!parse_view(view_options[v], scene, fieldOfView, view_specs[v])) {
+			return -1;
+		}
+		scene.add_view({ glm::identity<glm::mat4>(), 1.f, view_specs[v].follow, view_specs[v].distance });
+	}
+	size_t view_count = 1 + view_specs.size();
+
+	// the main ring and halo, 1.4 to 1.81 jupiter radii out
+	float jupiter_radius = scene.bodies()[jupiter].radius;
+	ParticleField ring = ParticleField::ring(ring_particles, 1.4f * jupiter_radius, 1.81f * jupiter_radius,
+	                                         0.05f, 8., 0.002f, 0.02f);
+
 
 	if (!glfwInit())
 	{
@@ -242,10 +467,15 @@ int main(int ac, char * av[]) {
 	glfwWindowHint(GLFW_BLUE_BITS, mode->blueBits);
 	glfwWindowHint(GLFW_REFRESH_RATE, mode->refreshRate);
 
-	auto window = glfwCreateWindow(mode->width,
-	                          mode->height,
+	if(offscreen) {
+		// still need a surface for the context, but nothing is drawn to it
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
+
+	auto window = glfwCreateWindow(offscreen ? 64 : mode->width,
+	                          offscreen ? 64 : mode->height,
 	                          "GL Planets",
-	                          monitor,
+	                          offscreen ? NULL : monitor,
 	                          NULL);
 	
 	if (!window)
@@ -264,6 +494,16 @@ int main(int ac, char * av[]) {
 	glewExperimental = GL_TRUE;
   	glewInit();
 
+	GLState::current().set_enabled(!no_state_cache);
+
+	// started before any texture or program exists so the trace can be replayed on its own
+	GLTrace trace;
+	if(!trace_path.empty()) {
+		if(!trace.start(trace_path, trace_frames)) {
+			return -1;
+		}
+	}
+
 	GLint maxTextureUnits;
 	glGetIntegerv(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS, &maxTextureUnits);
 
@@ -282,27 +522,112 @@ int main(int ac, char * av[]) {
 	glfwSwapInterval(1);
 
 
+	// decodes textures off the render thread, uploads happen in poll()
+	AsyncLoader loader(started);
+	loader.on_ready(glfwPostEmptyEvent);
+
+	// decodes in place at startup with --sync-load, on the loader otherwise
+	auto make_texture = [&](string const & path) {
+		return sync_load ? std::make_unique<Texture>(path) : std::make_unique<Texture>(path, loader);
+	};
+
+	// the catalog replaces the starfield image, which is then never loaded
+	StarCatalog star_catalog;
+	if(!star_catalog_path.empty()) {
+		double started = glfwGetTime();
+		if(!star_catalog.open(star_catalog_path)) {
+			return -1;
+		}
+		printf("star catalog: %zu stars in %zu cells, %.1fMB mapped in %.2fms\n",
+		    star_catalog.size(), star_catalog.cells(), star_catalog.bytes() / 1e6, (glfwGetTime() - started) * 1e3);
+	}
+
+	unique_ptr<SequenceSource> sequence;
+	if(!sequence_directory.empty()) {
+		sequence = std::make_unique<SequenceSource>(SequenceSource::list(sequence_directory),
+			sequence_rate, sequence_ahead, sequence_threads);
+		if(!sequence->is_valid()) {
+			return -1;
+		}
+		printf("sequence: %zu frames %dx%d at %g per second, %.1fMB decoded ahead\n",
+		    sequence->frames(), sequence->width(), sequence->height(), sequence_rate, sequence->bytes() / 1e6);
+	}
+
 	// Texture io_texture(texture_path);
-	Texture star_texture(starfield_path);
-    Texture dem_texture(dem_path);
+	unique_ptr<Texture> star_texture_ptr;
+	if(!star_catalog.is_open()) {
+		star_texture_ptr = make_texture(starfield_path);
+	}
+    auto dem_texture_ptr = make_texture(dem_path);
+    Texture & dem_texture = *dem_texture_ptr;
     // Texture normal_texture(normal_path);
 
 	// if(!io_texture) {
 	// 	cerr << "unable to load texture '" << texture_path << "'\n";
 	// 	return -1;
 	// }
-	if(!star_texture) {
+	if(star_texture_ptr && !*star_texture_ptr) {
 		cerr << "unable to load starfield '" << starfield_path << "'\n";
 		return -1;
 	}
 
+	// eclipses passed to the shader per frame, any beyond this are dropped
+	const size_t max_shadows = 16;
+
+	vector<pair<string,string>> defines = {
+        { "PLANETS", std::to_string(scene.size()) },
+        { "MAX_SHADOWS", std::to_string(max_shadows) }
+    };
+	if(star_catalog.is_open()) {
+		defines.push_back({ "STAR_CATALOG", "1" });
+	}
+	if(aa_samples > 1) {
+		defines.push_back({ "AA_SAMPLES", std::to_string(aa_samples) });
+	}
+	if(sequence) {
+		defines.push_back({ "SEQUENCE", std::to_string(jupiter) });
+	}
+	vector<pair<string,string>> point_defines = {
+		{ "PLANETS", std::to_string(scene.size()) }
+	};
+	if(view_count > 1) {
+		defines.push_back({ "VIEWS", std::to_string(view_count) });
+		point_defines.push_back({ "VIEWS", std::to_string(view_count) });
+	}
+
+	// jupiter's scattering tables, computed once and then read from the cache
+	Atmosphere atmosphere(AtmosphereParameters::jupiter());
+	unique_ptr<LookupTable> transmittance_table, scattering_table;
+	if(!no_atmosphere) {
+		string cache_path = atmosphere_cache + "/" + atmosphere.cache_name();
+		if(!atmosphere.load(cache_path)) {
+			double started = glfwGetTime();
+			ThreadPool pool;
+			atmosphere.precompute(pool);
+			printf("atmosphere tables computed in %.2fs on %zu threads\n", glfwGetTime() - started, pool.size());
+
+			std::error_code ec;
+			std::filesystem::create_directories(atmosphere_cache, ec);
+			if(!atmosphere.save(cache_path)) {
+				cerr << "could not cache atmosphere tables in '" << cache_path << "'\n";
+			}
+		}
+
+		transmittance_table = std::make_unique<LookupTable>(atmosphere.transmittance_data(),
+			Atmosphere::transmittance_width, Atmosphere::transmittance_height);
+		scattering_table = std::make_unique<LookupTable>(atmosphere.scattering_data(),
+			Atmosphere::scattering_width, Atmosphere::scattering_height, Atmosphere::scattering_r);
+
+		auto atmosphere_defines = atmosphere.defines();
+		defines.insert(defines.end(), atmosphere_defines.begin(), atmosphere_defines.end());
+		defines.push_back({ "ATMOSPHERE_BODY", std::to_string(jupiter) });
+	}
+
 	Program program;
 	bool success;
 	tie(program, success) = Program::from_shader_files(vertex_shader, fragment_shader, {
         "GL_EXT_texture_array"
-    }, {
-        { "PLANETS", "2" }
-    });
+    }, defines);
 	if(!success) {
 		std::cerr << "error making program" << std::endl;
         std::cerr << "vertex log: " << program.vertex_info_log() << std::endl;
@@ -310,15 +635,54 @@ int main(int ac, char * av[]) {
         return -1;
 	}
 
+	Program particle_program;
+	if(ring.size() > 0) {
+		tie(particle_program, success) = Program::from_shader_files(particle_vertex_shader, particle_fragment_shader, {}, point_defines);
+		if(!success) {
+			std::cerr << "error making particle program" << std::endl;
+			std::cerr << "vertex log: " << particle_program.vertex_info_log() << std::endl;
+			std::cerr << "fragment log: " << particle_program.fragment_info_log() << std::endl;
+			return -1;
+		}
+	}
+
+	Program star_program;
+	if(star_catalog.is_open()) {
+		tie(star_program, success) = Program::from_shader_files(star_vertex_shader, star_fragment_shader, {}, point_defines);
+		if(!success) {
+			std::cerr << "error making star program" << std::endl;
+			std::cerr << "vertex log: " << star_program.vertex_info_log() << std::endl;
+			std::cerr << "fragment log: " << star_program.fragment_info_log() << std::endl;
+			return -1;
+		}
+	}
+
 #ifdef DEBUG
-	// During init, enable debug output
+	// During init, enable debug output.  the callback only queues each
+	// message, a thread of the log's own prints them
+	DebugMessageLog debug_log;
 	glEnable( GL_DEBUG_OUTPUT );
 	// glDebugMessageControl(GL_DEBUG_SOURCE_API​, 0​, GL_DEBUG_SEVERITY_NOTIFICATION​, 0​, nullptr​, GL_TRUE​);
-	glDebugMessageCallback( MessageCallback, 0 );
+	glDebugMessageCallback( DebugMessageLog::callback, &debug_log );
 #endif
 
+	// each extra view is projected for the part of the frame it covers
+	int frame_width = 0, frame_height = 0;
+	auto size_views = [&](int width, int height) {
+		frame_width = width;
+		frame_height = height;
+		for(size_t v = 0; v < view_specs.size(); v++) {
+			ViewSpec const & spec = view_specs[v];
+			float w = spec.rect.z * width, h = spec.rect.w * height;
+			scene.set_view_projection(v + 1, glm::perspective(spec.fov, w / h, near, far), h);
+		}
+	};
+
 	// handle resize
 	glm::mat4 projection = glm::perspective(fieldOfView, (float)mode->width / (float)mode->height, near, far);
+	scene.set_projection(projection);
+	scene.set_viewport_height((float)mode->height);
+	size_views(mode->width, mode->height);
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glfwSwapBuffers(window);
@@ -326,6 +690,8 @@ int main(int ac, char * av[]) {
 
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
+	GL_TRACE(enable, GLenum(GL_CULL_FACE));
+	GL_TRACE(cull_face, GLenum(GL_BACK));
 
 	time_of_first_swap = glfwGetTime();
 	n_frames = 0;
@@ -342,76 +708,483 @@ int main(int ac, char * av[]) {
 	};
 
 
-    auto camera_orbit = Orbit(10. /* km */);
-    auto io_orbit = Orbit(1821. /* km */);
-    auto jupiter_orbit = Orbit(740000. /* km */);
-
-
-
+	// render side copies of the latest simulation state, the uniforms point here
 	glm::mat4 mv;
+	glm::mat4 vp;
+	float pixels_per_unit = 0.f;
+	glm::vec3 pixel_x, pixel_y;
 	glm::vec3 camera;
 	glm::vec3 sun;
-    glm::vec3 position[] = { glm::vec3(50,0,0), glm::vec3(0,0,0) };
-    float radius[] = { 35., 5. }; // km
+    vector<glm::vec3> position(scene.size());
+    vector<float> radius(scene.size()); // km
+    vector<glm::vec4> shadow_occluder(max_shadows);
+    vector<float> shadow_receiver(max_shadows);
+    float shadow_count = 0.f;
+    size_t shadows_dropped = 0;
+    // 0 full, 1 Lambert, 2 flat, see sphere.frag
+    vector<float> shading(scene.size(), 0.f);
+    vector<glm::vec3> albedo(scene.size(), glm::vec3(0.5f));
+    bool albedo_known = false;
+    size_t shaded[3] = { 0, 0, 0 };
+    // pixels on a limb and the rays they add, estimated per state
+    double limb_pixels = 0., limb_pixels_max = 0., frame_pixels = 0.;
+    size_t limb_updates = 0;
     std::array<string,2> texture_paths = { "../img/20180511_jupiter_map_css_plus_juno_bj.jpg", texture_path };
     std::array<string,2> norm_paths = { "../img/io_normal_4096x2048.jpg", "../img/io_normal_4096x2048.jpg" };
 
 	ArrayBuffer<float,2> corners_buffer(corners);
 	UniformMatrix<float,4> inverse_transform(mv);
+	Uniform<float,3> pixel_step_x(pixel_x);
+	Uniform<float,3> pixel_step_y(pixel_y);
 	Uniform<float,3> camera_position(camera);
 	Uniform<float,3> sun_position(sun);
-    UniformArray<float,3> planet_position(position, 2);
-    UniformArray<float,1> planet_radius(radius, 2);
-    TextureArray planet_textures(texture_paths);
-    TextureArray planet_normals(norm_paths);
+    UniformArray<float,3> planet_position(position.data(), position.size());
+    UniformArray<float,1> planet_radius(radius.data(), radius.size());
+    UniformArray<float,4> shadow_occluders(shadow_occluder.data(), shadow_occluder.size());
+    UniformArray<float,1> shadow_receivers(shadow_receiver.data(), shadow_receiver.size());
+    UniformArray<float,1> body_shading(shading.data(), shading.size());
+    UniformArray<float,3> body_albedo(albedo.data(), albedo.size());
+    // every view's, uploaded in one call each per state, and the index of
+    // the view being drawn
+    vector<glm::mat4> view_inv(view_count), view_vp(view_count);
+    vector<glm::vec3> view_camera(view_count), view_pixel_x(view_count), view_pixel_y(view_count);
+    vector<float> view_pixels_per_unit(view_count);
+    float view_index = 0.f;
+    UniformMatrixArray<float,4> view_inverse_transforms(view_inv.data(), view_count);
+    UniformMatrixArray<float,4> view_projections(view_vp.data(), view_count);
+    UniformArray<float,3> view_cameras(view_camera.data(), view_count);
+    UniformArray<float,3> view_pixel_steps_x(view_pixel_x.data(), view_count);
+    UniformArray<float,3> view_pixel_steps_y(view_pixel_y.data(), view_count);
+    UniformArray<float,1> view_pixel_scales(view_pixels_per_unit.data(), view_count);
+    auto make_texture_array = [&](std::array<string,2> const & paths) {
+        return sync_load ? std::make_unique<TextureArray>(paths) : std::make_unique<TextureArray>(paths, loader);
+    };
+    auto planet_textures_ptr = make_texture_array(texture_paths);
+    auto planet_normals_ptr = make_texture_array(norm_paths);
+    TextureArray & planet_textures = *planet_textures_ptr;
+    TextureArray & planet_normals = *planet_normals_ptr;
 	
 	auto drawer = program.make_drawer()
 		("camera", camera_position )
 		("texture", planet_textures )
         ("norm", planet_normals )
         ("dem", dem_texture )
-		("starfield", star_texture )
 		("sun", sun_position )
 		("inv", inverse_transform )
+		("pixel_x", pixel_step_x )
+		("pixel_y", pixel_step_y )
 		("corner", corners_buffer )
         ("radius", planet_radius )
         ("position", planet_position )
+        ("sun_radius", sun_radius )
+        ("shadow_occluder", shadow_occluders )
+        ("shadow_receiver", shadow_receivers )
+        ("shadow_count", shadow_count )
+        ("shading", body_shading )
+        ("albedo", body_albedo )
+        ("view_inv", view_inverse_transforms )
+        ("view_camera", view_cameras )
+        ("view_pixel_x", view_pixel_steps_x )
+        ("view_pixel_y", view_pixel_steps_y )
 	;
+	drawer.per_draw("view", view_index);
+	if(star_texture_ptr) {
+		drawer("starfield", *star_texture_ptr);
+	}
+	unique_ptr<SequenceTexture> sequence_texture;
+	if(sequence) {
+		sequence_texture = std::make_unique<SequenceTexture>(sequence->width(), sequence->height());
+		drawer
+			("sequence", *sequence_texture )
+			("sequence_layer", sequence_texture->layer() )
+		;
+	}
+	if(!no_atmosphere) {
+		drawer
+			("transmittance", *transmittance_table )
+			("scattering", *scattering_table )
+		;
+	}
+
+	// ring positions are propagated on the pool and streamed every state
+	ThreadPool ring_pool(ring.size() > 0 ? ThreadPool::default_size() : 1);
+	vector<float> ring_xyz(3 * ring.size());
+	unique_ptr<StreamBuffer<float,3>> ring_positions;
+	unique_ptr<ArrayBuffer<float,1>> ring_sizes;
+	unique_ptr<programParameters> particle_drawer;
+	UniformMatrix<float,4> view_projection(vp);
+	glm::vec3 ring_color(0.62f, 0.55f, 0.47f);
+	Uniform<float,3> particle_color(ring_color);
+	double ring_seconds = 0.;
+	size_t ring_updates = 0;
+	if(ring.size() > 0) {
+		ring_positions = std::make_unique<StreamBuffer<float,3>>(ring.size());
+		ring_sizes = std::make_unique<ArrayBuffer<float,1>>(ring.size(), ring.sizes());
+		particle_drawer = std::make_unique<programParameters>(particle_program.make_drawer());
+		(*particle_drawer)
+			("particle", *ring_positions )
+			("particle_size", *ring_sizes )
+			("view_projection", view_projection )
+			("camera", camera_position )
+			("sun", sun_position )
+			("position", planet_position )
+			("radius", planet_radius )
+			("pixels_per_unit", pixels_per_unit )
+			("particle_color", particle_color )
+			("view_vp", view_projections )
+			("view_camera", view_cameras )
+			("view_pixels_per_unit", view_pixel_scales )
+		;
+		particle_drawer->per_draw("view", view_index);
+	}
+
+	// catalog stars in view are gathered and streamed every state.  the
+	// limit goes 5 magnitudes fainter for every tenfold zoom
+	float magnitude_limit = std::min(star_catalog.faintest(),
+		star_magnitude + 5.f * std::log10(75.f * glm::pi<float>() / 180.f / fieldOfView));
+	vector<float> star_xyzm, star_bv;
+	unique_ptr<StreamBuffer<float,4>> star_buffer;
+	unique_ptr<StreamBuffer<float,1>> star_color_buffer;
+	unique_ptr<programParameters> star_drawer;
+	double star_seconds = 0.;
+	size_t star_updates = 0, star_cells = 0, stars_drawn = 0;
+	if(star_catalog.is_open()) {
+		star_buffer = std::make_unique<StreamBuffer<float,4>>(0);
+		star_color_buffer = std::make_unique<StreamBuffer<float,1>>(0);
+		star_drawer = std::make_unique<programParameters>(star_program.make_drawer());
+		(*star_drawer)
+			("star", *star_buffer )
+			("star_color", *star_color_buffer )
+			("view_projection", view_projection )
+			("camera", camera_position )
+			("position", planet_position )
+			("radius", planet_radius )
+			("magnitude_limit", magnitude_limit )
+			("view_vp", view_projections )
+			("view_camera", view_cameras )
+		;
+		star_drawer->per_draw("view", view_index);
+	}
+
+	// pixels each view covers
+	auto view_size = [&](size_t v, float & width, float & height) {
+		glm::mat4 const & projection = v == 0 ? scene.projection() : scene.views()[v - 1].projection;
+		height = v == 0 ? scene.viewport_height() : scene.views()[v - 1].viewport_height;
+		width = height * projection[1][1] / projection[0][0];
+	};
+
+	auto apply_state = [&](SceneState const & state) {
+		for(size_t v = 0; v < view_count; v++) {
+			ViewState const & view = state.views[v];
+			float width, height;
+			view_size(v, width, height);
+			glm::mat4 const & projection = v == 0 ? scene.projection() : scene.views()[v - 1].projection;
+			view_inv[v] = view.inverse_view_projection;
+			view_vp[v] = view.view_projection;
+			view_camera[v] = view.camera;
+			view_pixels_per_unit[v] = projection[1][1] * 0.5f * height;
+			// the ray direction is linear in normalised device coordinates
+			view_pixel_x[v] = glm::vec3(view_inv[v][0]) * (2.f / width);
+			view_pixel_y[v] = glm::vec3(view_inv[v][1]) * (2.f / height);
+		}
+		mv = view_inv[0];
+		vp = view_vp[0];
+		pixels_per_unit = view_pixels_per_unit[0];
+		pixel_x = view_pixel_x[0];
+		pixel_y = view_pixel_y[0];
+		camera = state.camera;
+		sun = state.sun;
+		std::copy(state.position.begin(), state.position.end(), position.begin());
+		std::copy(state.radius.begin(), state.radius.end(), radius.begin());
+
+		size_t shadows = std::min(state.shadows.size(), max_shadows);
+		for(size_t i = 0; i < shadows; i++) {
+			ShadowPair const & pair = state.shadows[i];
+			shadow_occluder[i] = glm::vec4(state.position[pair.occluder], state.radius[pair.occluder]);
+			shadow_receiver[i] = (float)pair.receiver;
+		}
+		shadow_count = (float)shadows;
+		shadows_dropped += state.shadows.size() - shadows;
+
+		// the flat tier stands in for the texture, so it takes its mean
+		// colour once that is loaded.  bodies past the last layer share it
+		if(!albedo_known && planet_textures.is_full_quality()) {
+			for(size_t i = 0; i < albedo.size(); i++) {
+				planet_textures.mean_color(std::min(i, planet_textures.layers() - 1), albedo[i]);
+			}
+			albedo_known = true;
+		}
+
+		for(size_t i = 0; i < shading.size(); i++) {
+			float pixels = state.pixel_radius[i];
+			int tier = no_lod || pixels >= lod_full ? 0 : (pixels >= lod_flat ? 1 : 2);
+			shading[i] = (float)tier;
+			shaded[tier]++;
+		}
+
+		// sphere.frag gives extra rays to the ring of pixels within one of
+		// each silhouette, pi((R + 1)^2 - (R - 1)^2) of them for a body R
+		// pixels in radius that is on screen and does not hold the camera
+		if(aa_samples > 1) {
+			double pixels = 0.;
+			frame_pixels = 0.;
+			for(size_t v = 0; v < view_count; v++) {
+				float viewport_width, viewport_height;
+				view_size(v, viewport_width, viewport_height);
+				double view_pixels = 0.;
+				for(size_t i = 0; i < shading.size(); i++) {
+					glm::vec4 clip = view_vp[v] * glm::vec4(state.position[i], 1.f);
+					glm::vec3 offset = state.position[i] - view_camera[v];
+					float r = state.radius[i], d2 = glm::dot(offset, offset);
+					if(clip.w <= 0.f || d2 <= r * r) continue;
+					float R = view_pixels_per_unit[v] * r / std::sqrt(d2 - r * r);
+					if(R >= viewport_height) continue;
+					float x = std::abs(clip.x / clip.w) * 0.5f * viewport_width;
+					float y = std::abs(clip.y / clip.w) * 0.5f * viewport_height;
+					if(x - R > 0.5f * viewport_width || y - R > 0.5f * viewport_height) continue;
+					float inner = std::max(R - 1.f, 0.f);
+					view_pixels += glm::pi<double>() * ((R + 1.f) * (R + 1.f) - inner * inner);
+				}
+				pixels += std::min(view_pixels, (double)viewport_width * viewport_height);
+				frame_pixels += (double)viewport_width * viewport_height;
+			}
+			limb_pixels += pixels;
+			limb_pixels_max = std::max(limb_pixels_max, pixels);
+			limb_updates++;
+		}
+
+		// offline renders wait for every frame, live ones show what is ready
+		if(sequence) {
+			unsigned char const * frame = sequence->update(state.time, offscreen);
+			if(frame != nullptr) sequence_texture->upload(frame);
+		}
+
+		if(ring_positions) {
+			double started = glfwGetTime();
+			ring.propagate(state.time, state.position[jupiter], ring_xyz.data(), &ring_pool);
+			ring_positions->update(ring_xyz.data());
+			ring_seconds += glfwGetTime() - started;
+			ring_updates++;
+		}
+
+		if(star_drawer) {
+			double started = glfwGetTime();
+			star_cells += star_catalog.query(view_vp.data(), view_count, magnitude_limit, star_xyzm, star_bv);
+			star_buffer->update(star_xyzm.data(), star_bv.size());
+			star_color_buffer->update(star_bv.data(), star_bv.size());
+			star_seconds += glfwGetTime() - started;
+			stars_drawn += star_bv.size();
+			star_updates++;
+		}
+	};
+
+	// the part of the frame view v covers
+	auto set_viewport = [&](size_t v) {
+		glm::vec4 rect = v == 0 ? glm::vec4(0.f, 0.f, 1.f, 1.f) : view_specs[v - 1].rect;
+		GLint x = GLint(rect.x * frame_width), y = GLint(rect.y * frame_height);
+		GLsizei width = GLsizei(rect.z * frame_width), height = GLsizei(rect.w * frame_height);
+		glViewport(x, y, width, height);
+		GL_TRACE(viewport, x, y, width, height);
+	};
+
+	// per view and one view after the other, so later ones cover earlier
+	// ones: bodies first, then the stars added where the sky is, then the
+	// ring blended over both.  the uniforms go up once for all views
+	vector<double> view_seconds(view_count, 0.);
+	size_t view_frames = 0;
+	auto draw = [&]() {
+		drawer.set_uniforms();
+		if(star_drawer) star_drawer->set_uniforms();
+		if(particle_drawer) particle_drawer->set_uniforms();
+
+		for(size_t v = 0; v < view_count; v++) {
+			double started = glfwGetTime();
+			if(view_count > 1) {
+				set_viewport(v);
+				view_index = (float)v;
+			}
+
+			drawer.redraw(GL_TRIANGLE_FAN);
+			if(star_drawer || particle_drawer) {
+				glEnable(GL_BLEND);
+				GL_TRACE(enable, GLenum(GL_BLEND));
+				if(star_drawer && !star_bv.empty()) {
+					glBlendFunc(GL_ONE, GL_ONE);
+					GL_TRACE(blend_func, GLenum(GL_ONE), GLenum(GL_ONE));
+					star_drawer->redraw(GL_POINTS, star_bv.size());
+				}
+				if(particle_drawer) {
+					glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+					GL_TRACE(blend_func, GLenum(GL_ONE), GLenum(GL_ONE_MINUS_SRC_ALPHA));
+					particle_drawer->redraw(GL_POINTS);
+				}
+				glDisable(GL_BLEND);
+				GL_TRACE(disable, GLenum(GL_BLEND));
+			}
+			view_seconds[v] += glfwGetTime() - started;
+		}
+		view_frames++;
+	};
+	auto print_ring = [&]() {
+		if(ring_updates == 0) return;
+		double ms = ring_seconds * 1e3 / ring_updates;
+		printf("%zu ring particles, propagated and streamed in %.3fms per state = %.0f particles/ms\n",
+		    ring.size(), ms, ring.size() / ms);
+	};
+	auto print_aa = [&]() {
+		if(limb_updates == 0) return;
+		double mean = limb_pixels / limb_updates;
+		printf("%.0f limb pixels per frame (max %.0f) at %d rays, %.0f extra rays = %.2f%% more than one per pixel\n",
+		    mean, limb_pixels_max, aa_samples, mean * (aa_samples - 1),
+		    100. * mean * (aa_samples - 1) / frame_pixels);
+	};
+	auto print_sequence = [&]() {
+		if(!sequence) return;
+		printf("sequence frames shown %zu, late %zu, dropped %zu, failed to decode %zu\n",
+		    sequence->shown(), sequence->late(), sequence->dropped(), sequence->failures());
+	};
+	// what each view after the first adds: the CPU time to submit its draws,
+	// its share of the per view uniforms, and the pixels it shades
+	auto print_views = [&]() {
+		if(view_count < 2 || view_frames == 0) return;
+		float width, height;
+		view_size(0, width, height);
+		double main_pixels = (double)width * height;
+		size_t uniform_bytes = sizeof(glm::mat4) * 2 + sizeof(glm::vec3) * 3 + sizeof(float);
+		printf("%zu views drawn %zu times, per view uniforms %zu bytes per state uploaded in one call per array\n",
+		    view_count, view_frames, view_count * uniform_bytes);
+		for(size_t v = 0; v < view_count; v++) {
+			view_size(v, width, height);
+			printf("view %zu: %.0fx%.0f, draws submitted in %.3fms per frame, %.1f%% of the main view's pixels\n",
+			    v, width, height, view_seconds[v] * 1e3 / view_frames, 100. * width * height / main_pixels);
+		}
+	};
+	auto print_stars = [&]() {
+		if(star_updates == 0) return;
+		printf("%.0f catalog stars to magnitude %.1f from %.0f cells, gathered and streamed in %.3fms per state\n",
+		    (double)stars_drawn / star_updates, magnitude_limit, (double)star_cells / star_updates,
+		    star_seconds * 1e3 / star_updates);
+	};
+
+	if(offscreen) {
+		size_views(offline.width, offline.height);
+		bool rendered = render_offline(offline, scene, [&](SceneState const & state) {
+			apply_state(state);
+			draw();
+		}, glm::perspective(fieldOfView, (float)offline.width / (float)offline.height, near, far));
+		printf("bodies shaded full %zu, lambert %zu, flat %zu times\n", shaded[0], shaded[1], shaded[2]);
+		print_aa();
+		print_sequence();
+		print_views();
+		print_ring();
+		print_stars();
+
+		loader.cancel();
+		glfwMakeContextCurrent(NULL);
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return rendered ? 0 : -1;
+	}
+
+	// frames for local consumers, read back a few frames behind the GPU
+	ShmRingWriter shm_ring;
+	unique_ptr<PixelReader> shm_reader;
+	int fb_width, fb_height;
+	glfwGetFramebufferSize(window, &fb_width, &fb_height);
+	GL_TRACE(viewport, GLint(0), GLint(0), GLsizei(fb_width), GLsizei(fb_height));
+	if(!shm_name.empty()) {
+		if(!shm_ring.create(shm_name, shm_slots, fb_width * fb_height * 4)) {
+			return -1;
+		}
+		shm_reader = std::make_unique<PixelReader>(fb_width, fb_height);
+		printf("publishing %dx%d frames to shared memory '%s'\n", fb_width, fb_height, shm_name.c_str());
+	}
+	auto to_shm = [&shm_ring](uint64_t rendered_ns, unsigned char const * rgba, int width, int height) {
+		shm_ring.publish(rgba, width, height, width * 4, shm_format_rgba8, shm_flag_bottom_up, rendered_ns);
+	};
 
+	WindowEvents events;
+	glfwSetWindowUserPointer(window, &events);
+	glfwSetKeyCallback(window, key_callback);
+	glfwSetWindowRefreshCallback(window, window_damaged_callback);
+	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+
+	Simulation simulation(scene, glfwGetTime, sim_rate);
+	if(lazy) {
+		// each new state wakes the loop, like a finished texture does
+		simulation.on_step(glfwPostEmptyEvent);
+	}
+	simulation.start();
+
+	size_t frames_skipped = 0;
+	double time_waiting = 0.;
+	double loop_started = glfwGetTime();
 	while (!glfwWindowShouldClose(window))
 	{
-		/* Process window events */
-		glfwPollEvents();
+		/* Process window events, in lazy mode sleeping until there are some.
+		   without a simulation thread nothing else wakes the loop, so it
+		   polls at the refresh rate instead */
+		if(lazy) {
+			double started = glfwGetTime();
+			if(simulation.threaded() || simulation.paused()) {
+				glfwWaitEvents();
+			} else {
+				glfwWaitEventsTimeout(1. / mode->refreshRate);
+			}
+			time_waiting += glfwGetTime() - started;
+		} else {
+			glfwPollEvents();
+		}
+
+		if(events.toggle_pause) {
+			events.toggle_pause = false;
+			simulation.set_paused(!simulation.paused());
+			printf("%s\n", simulation.paused() ? "paused" : "resumed");
+		}
+
+		/* Swap in any textures that finished decoding */
+		if(loader.poll() > 0 && loader.done()) {
+			printf("full quality after %.1fms\n", loader.time_to_full_quality_ms());
+		}
+
+		/* Pick up the latest scene state without waiting on the simulation */
+		if(simulation.update()) {
+			apply_state(simulation.state());
+		}
+
+		/* Nothing the draws read has changed, the last frame still stands */
+		if(lazy) {
+			bool dirty = drawer.changed();
+			if(particle_drawer) dirty = particle_drawer->changed() || dirty;
+			if(star_drawer) dirty = star_drawer->changed() || dirty;
+			if(!dirty && !events.damaged) {
+				frames_skipped++;
+				continue;
+			}
+			events.damaged = false;
+		}
 		
 		/* Clear the framebuffer to black */
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		glm::mat4 m = glm::identity<glm::mat4>();
-		glm::mat4 view = glm::identity<glm::mat4>();
-
-		view = glm::translate(view, glm::vec3(0, 0, -10.));
-		view = glm::rotate(view, (float)time_now / (float)400., glm::vec3(0, 0.5, 0));
-        // view = glm::rotate(view, (float)time_now / (float)65., glm::vec3(0, 0, 1));
-
-		mv = projection * view * m;
-		mv = glm::inverse(mv);
-		
-		glm::mat4 inv = glm::inverse(view);
-		camera = inv * glm::vec4(0, 0, 0, 1);
+		GL_TRACE(clear, GLbitfield(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
 		// cout << "camera: " << camera.x << " " << camera.y << " " << camera.z << " " << camera.w << endl;
 
-		sun = glm::vec3(
-			glm::cos((float)time_now / (float)60.), 
-			0.,
-			-glm::sin((float)time_now / (float)60.));
+		draw();
 
-		drawer.draw_arrays_triangle_fan();
-		
+		if(shm_reader) {
+			shm_reader->read(monotonic_ns(), to_shm);
+			shm_reader->collect(to_shm);
+		}
 	
 		/* Display framebuffer */
 		glfwSwapBuffers(window);
+		GL_TRACE(frame_end);
 
+		if(n_frames == 0) {
+			loader.frame_presented();
+			printf("first frame after %.1fms\n", loader.time_to_first_frame_ms());
+		}
 		
 		/* Update fps counter */
 		time_now = glfwGetTime();
@@ -426,8 +1199,52 @@ int main(int ac, char * av[]) {
 	    n_frames,
 	    time_of_last_swap - time_of_first_swap,
 	    (double)n_frames / (time_of_last_swap - time_of_first_swap));
+	if(lazy) {
+		// the GPU only works on the vsync intervals that got a frame
+		double elapsed = glfwGetTime() - loop_started;
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		double cpu = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+		printf("lazy redraw: %zu frames drawn, %zu wakeups skipped, render thread asleep %.1fs of %.1fs\n",
+		    n_frames, frames_skipped, time_waiting, elapsed);
+		printf("GPU idle for %.0f%% of vsync intervals, process CPU time %.2fs = %.1f%% of one core\n",
+		    100. * std::max(0., 1. - n_frames / (elapsed * mode->refreshRate)), cpu, 100. * cpu / elapsed);
+	}
+	GLState::current().print_counters();
+#ifdef DEBUG
+	// nothing more is queued once the callback is gone, so the counts are final
+	glDebugMessageCallback(nullptr, nullptr);
+	debug_log.stop();
+	debug_log.print_counters();
+#endif
+	printf("bodies shaded full %zu, lambert %zu, flat %zu times\n", shaded[0], shaded[1], shaded[2]);
+	print_aa();
+	print_sequence();
+	print_views();
+	print_ring();
+	print_stars();
+	if(shadows_dropped > 0) {
+		printf("%zu eclipses dropped, more than %zu at once\n", shadows_dropped, max_shadows);
+	}
+	printf("%zu simulation steps, %.3fms per step\n",
+	    simulation.steps(),
+	    simulation.mean_step_ms());
+	printf("time to first frame %.1fms, time to full quality %.1fms\n",
+	    loader.time_to_first_frame_ms(),
+	    loader.time_to_full_quality_ms());
+	if(!trace_path.empty()) {
+		printf("traced %zu frames, %zu bytes into '%s'\n", trace.frames(), trace.bytes(), trace_path.c_str());
+	}
+
 
+	if(shm_reader) {
+		shm_reader->flush(to_shm);
+		printf("%llu frames published to shared memory\n", (unsigned long long)shm_ring.published());
+		shm_reader.reset();
+	}
 
+	simulation.stop();
+	loader.cancel();
 
 	glfwMakeContextCurrent(NULL);
 	
@@ -0,0 +1,530 @@
+// replays a trace recorded with gl_planets --trace into an offscreen target,
+// as fast as the GPU allows and without loading any assets or running the
+// scene, so the GL workload can be timed and bisected on its own.
+//
+// the first pass replays the whole trace, including the uploads and program
+// builds of frame 0.  every further --loops pass replays frames 1..N only.
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+#include "gl_trace.hpp"
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using std::cout;
+using std::cerr;
+using std::string;
+
+static char const * op_names[] = {
+	"", "gen_texture", "gen_buffer", "create_shader", "create_program", "uniform_location",
+	"attrib_location", "use_program", "active_texture", "bind_texture", "bind_buffer",
+	"enable_attrib", "disable_attrib", "attrib_pointer", "pixel_store", "tex_parameter",
+	"tex_image_2d", "tex_image_3d", "tex_sub_image_3d", "buffer_data", "buffer_sub_data",
+	"uniform1i", "uniform1f", "uniform1fv", "uniform3fv", "uniform4fv", "uniform_matrix4fv",
+	"clear", "enable", "cull_face", "viewport", "draw_arrays", "frame_end",
+	"disable", "blend_func", "read_pixels", "fence_sync", "client_wait_sync", "delete_sync",
+	"map_buffer_range", "unmap_buffer"
+};
+static_assert(sizeof(op_names) / sizeof(op_names[0]) == size_t(TraceOp::op_count), "one name per trace op");
+
+void error_callback(int, const char * desc) {
+	cerr << "ERROR: " << desc << "\n";
+}
+
+class Replayer {
+private:
+	typedef std::chrono::steady_clock clock;
+
+	struct op_time {
+		size_t calls = 0;
+		double seconds = 0.;
+	};
+
+	TraceReader & trace_;
+	bool finish_each_call_;
+
+	// recorded names to the ones created here
+	std::map<GLuint, GLuint> textures_;
+	std::map<GLuint, GLuint> buffers_;
+	std::map<GLuint, GLuint> shaders_;
+	std::map<GLuint, GLuint> programs_;
+	std::map<std::pair<GLuint, GLint>, GLint> uniforms_;
+	std::map<std::pair<GLuint, GLint>, GLint> attribs_;
+	std::map<uint64_t, GLsync> syncs_;
+	GLuint program_; // as recorded
+
+	GLuint framebuffer_;
+	GLuint color_;
+	GLuint depth_;
+
+	std::array<op_time, size_t(TraceOp::op_count)> times_;
+
+	static GLuint lookup(std::map<GLuint, GLuint> const & names, GLuint name) {
+		auto it = names.find(name);
+		return it != names.end() ? it->second : name;
+	}
+	GLint uniform(GLint location) const {
+		auto it = uniforms_.find(std::make_pair(program_, location));
+		return it != uniforms_.end() ? it->second : -1;
+	}
+	GLint attrib(GLint index) const {
+		auto it = attribs_.find(std::make_pair(program_, index));
+		return it != attribs_.end() ? it->second : index;
+	}
+
+	// everything is drawn here instead of a window, sized by the first viewport
+	void make_target(GLsizei width, GLsizei height) {
+		glGenRenderbuffers(1, &color_);
+		glBindRenderbuffer(GL_RENDERBUFFER, color_);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glGenRenderbuffers(1, &depth_);
+		glBindRenderbuffer(GL_RENDERBUFFER, depth_);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+		glGenFramebuffers(1, &framebuffer_);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_);
+		if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			cerr << "framebuffer " << width << "x" << height << " is incomplete\n";
+		}
+	}
+
+	// issues one record.  `setup` is false on repeated passes, where names
+	// and programs already exist
+	void execute(TraceOp op, bool setup) {
+		uint32_t size;
+		void const * data;
+
+		switch(op) {
+		case TraceOp::gen_texture: {
+			GLuint name = trace_.get<GLuint>();
+			if(setup) glGenTextures(1, &textures_[name]);
+			break;
+		}
+		case TraceOp::gen_buffer: {
+			GLuint name = trace_.get<GLuint>();
+			if(setup) glGenBuffers(1, &buffers_[name]);
+			break;
+		}
+		case TraceOp::create_shader: {
+			GLuint name = trace_.get<GLuint>();
+			GLenum type = trace_.get<GLenum>();
+			string source = trace_.get_string();
+			if(!setup) break;
+
+			GLuint shader = glCreateShader(type);
+			char const * src = source.c_str();
+			glShaderSource(shader, 1, &src, NULL);
+			glCompileShader(shader);
+
+			GLint compiled;
+			glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+			if(!compiled) {
+				char log[1024];
+				glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+				cerr << "shader " << name << " failed to compile: " << log << "\n";
+			}
+			shaders_[name] = shader;
+			break;
+		}
+		case TraceOp::create_program: {
+			GLuint name = trace_.get<GLuint>();
+			GLuint vertex = trace_.get<GLuint>();
+			GLuint fragment = trace_.get<GLuint>();
+			if(!setup) break;
+
+			GLuint program = glCreateProgram();
+			glAttachShader(program, lookup(shaders_, vertex));
+			glAttachShader(program, lookup(shaders_, fragment));
+			glLinkProgram(program);
+
+			GLint linked;
+			glGetProgramiv(program, GL_LINK_STATUS, &linked);
+			if(!linked) {
+				char log[1024];
+				glGetProgramInfoLog(program, sizeof(log), NULL, log);
+				cerr << "program " << name << " failed to link: " << log << "\n";
+			}
+			programs_[name] = program;
+			break;
+		}
+		case TraceOp::uniform_location: {
+			GLuint program = trace_.get<GLuint>();
+			GLint location = trace_.get<GLint>();
+			string name = trace_.get_string();
+			if(setup) uniforms_[std::make_pair(program, location)] = glGetUniformLocation(lookup(programs_, program), name.c_str());
+			break;
+		}
+		case TraceOp::attrib_location: {
+			GLuint program = trace_.get<GLuint>();
+			GLint location = trace_.get<GLint>();
+			string name = trace_.get_string();
+			if(setup) attribs_[std::make_pair(program, location)] = glGetAttribLocation(lookup(programs_, program), name.c_str());
+			break;
+		}
+		case TraceOp::use_program:
+			program_ = trace_.get<GLuint>();
+			glUseProgram(lookup(programs_, program_));
+			break;
+		case TraceOp::active_texture:
+			glActiveTexture(GL_TEXTURE0 + trace_.get<GLuint>());
+			break;
+		case TraceOp::bind_texture: {
+			GLenum target = trace_.get<GLenum>();
+			glBindTexture(target, lookup(textures_, trace_.get<GLuint>()));
+			break;
+		}
+		case TraceOp::bind_buffer: {
+			GLenum target = trace_.get<GLenum>();
+			glBindBuffer(target, lookup(buffers_, trace_.get<GLuint>()));
+			break;
+		}
+		case TraceOp::enable_attrib:
+			glEnableVertexAttribArray(attrib(trace_.get<GLuint>()));
+			break;
+		case TraceOp::disable_attrib:
+			glDisableVertexAttribArray(attrib(trace_.get<GLuint>()));
+			break;
+		case TraceOp::attrib_pointer: {
+			GLuint index = trace_.get<GLuint>();
+			GLint components = trace_.get<GLint>();
+			GLenum type = trace_.get<GLenum>();
+			GLboolean normalized = trace_.get<GLboolean>();
+			GLsizei stride = trace_.get<GLsizei>();
+			uint64_t offset = trace_.get<uint64_t>();
+			glVertexAttribPointer(attrib(index), components, type, normalized, stride, reinterpret_cast<void const *>(uintptr_t(offset)));
+			break;
+		}
+		case TraceOp::pixel_store: {
+			GLenum pname = trace_.get<GLenum>();
+			glPixelStorei(pname, trace_.get<GLint>());
+			break;
+		}
+		case TraceOp::tex_parameter: {
+			GLenum target = trace_.get<GLenum>();
+			GLenum pname = trace_.get<GLenum>();
+			glTexParameteri(target, pname, trace_.get<GLint>());
+			break;
+		}
+		case TraceOp::tex_image_2d: {
+			GLenum target = trace_.get<GLenum>();
+			GLint level = trace_.get<GLint>();
+			GLint internal_format = trace_.get<GLint>();
+			GLsizei width = trace_.get<GLsizei>();
+			GLsizei height = trace_.get<GLsizei>();
+			GLenum format = trace_.get<GLenum>();
+			GLenum type = trace_.get<GLenum>();
+			data = trace_.get_blob(size);
+			glTexImage2D(target, level, internal_format, width, height, 0, format, type, data);
+			break;
+		}
+		case TraceOp::tex_image_3d: {
+			GLenum target = trace_.get<GLenum>();
+			GLint level = trace_.get<GLint>();
+			GLint internal_format = trace_.get<GLint>();
+			GLsizei width = trace_.get<GLsizei>();
+			GLsizei height = trace_.get<GLsizei>();
+			GLsizei depth = trace_.get<GLsizei>();
+			GLenum format = trace_.get<GLenum>();
+			GLenum type = trace_.get<GLenum>();
+			data = trace_.get_blob(size);
+			glTexImage3D(target, level, internal_format, width, height, depth, 0, format, type, size != 0 ? data : nullptr);
+			break;
+		}
+		case TraceOp::tex_sub_image_3d: {
+			GLenum target = trace_.get<GLenum>();
+			GLint level = trace_.get<GLint>();
+			GLint x = trace_.get<GLint>();
+			GLint y = trace_.get<GLint>();
+			GLint z = trace_.get<GLint>();
+			GLsizei width = trace_.get<GLsizei>();
+			GLsizei height = trace_.get<GLsizei>();
+			GLsizei depth = trace_.get<GLsizei>();
+			GLenum format = trace_.get<GLenum>();
+			GLenum type = trace_.get<GLenum>();
+			data = trace_.get_blob(size);
+			glTexSubImage3D(target, level, x, y, z, width, height, depth, format, type, data);
+			break;
+		}
+		case TraceOp::buffer_data: {
+			GLenum target = trace_.get<GLenum>();
+			GLenum usage = trace_.get<GLenum>();
+			data = trace_.get_blob(size);
+			glBufferData(target, size, data, usage);
+			break;
+		}
+		case TraceOp::buffer_sub_data: {
+			GLenum target = trace_.get<GLenum>();
+			GLintptr offset = GLintptr(trace_.get<uint64_t>());
+			data = trace_.get_blob(size);
+			glBufferSubData(target, offset, size, data);
+			break;
+		}
+		case TraceOp::uniform1i: {
+			GLint location = uniform(trace_.get<GLint>());
+			glUniform1i(location, trace_.get<GLint>());
+			break;
+		}
+		case TraceOp::uniform1f: {
+			GLint location = uniform(trace_.get<GLint>());
+			glUniform1f(location, trace_.get<GLfloat>());
+			break;
+		}
+		case TraceOp::uniform1fv:
+		case TraceOp::uniform3fv:
+		case TraceOp::uniform4fv:
+		case TraceOp::uniform_matrix4fv: {
+			GLint location = uniform(trace_.get<GLint>());
+			GLsizei count = trace_.get<GLsizei>();
+			auto values = static_cast<GLfloat const *>(trace_.get_blob(size));
+			if(values == nullptr) break;
+			if(op == TraceOp::uniform1fv) glUniform1fv(location, count, values);
+			else if(op == TraceOp::uniform3fv) glUniform3fv(location, count, values);
+			else if(op == TraceOp::uniform4fv) glUniform4fv(location, count, values);
+			else glUniformMatrix4fv(location, count, GL_FALSE, values);
+			break;
+		}
+		case TraceOp::clear:
+			glClear(trace_.get<GLbitfield>());
+			break;
+		case TraceOp::enable:
+			glEnable(trace_.get<GLenum>());
+			break;
+		case TraceOp::cull_face:
+			glCullFace(trace_.get<GLenum>());
+			break;
+		case TraceOp::disable:
+			glDisable(trace_.get<GLenum>());
+			break;
+		case TraceOp::blend_func: {
+			GLenum source = trace_.get<GLenum>();
+			glBlendFunc(source, trace_.get<GLenum>());
+			break;
+		}
+		case TraceOp::viewport: {
+			GLint x = trace_.get<GLint>();
+			GLint y = trace_.get<GLint>();
+			GLsizei width = trace_.get<GLsizei>();
+			GLsizei height = trace_.get<GLsizei>();
+			if(framebuffer_ == 0) make_target(x + width, y + height);
+			glViewport(x, y, width, height);
+			break;
+		}
+		case TraceOp::draw_arrays: {
+			GLenum mode = trace_.get<GLenum>();
+			GLint first = trace_.get<GLint>();
+			glDrawArrays(mode, first, trace_.get<GLsizei>());
+			break;
+		}
+		case TraceOp::read_pixels: {
+			GLint x = trace_.get<GLint>();
+			GLint y = trace_.get<GLint>();
+			GLsizei width = trace_.get<GLsizei>();
+			GLsizei height = trace_.get<GLsizei>();
+			GLenum format = trace_.get<GLenum>();
+			// always into a pack buffer, at its start
+			glReadPixels(x, y, width, height, format, trace_.get<GLenum>(), nullptr);
+			break;
+		}
+		case TraceOp::fence_sync: {
+			GLsync & sync = syncs_[trace_.get<uint64_t>()];
+			if(sync != nullptr) glDeleteSync(sync);
+			sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			break;
+		}
+		case TraceOp::client_wait_sync: {
+			auto it = syncs_.find(trace_.get<uint64_t>());
+			GLbitfield flags = trace_.get<GLbitfield>();
+			GLuint64 timeout = trace_.get<GLuint64>();
+			if(it != syncs_.end()) glClientWaitSync(it->second, flags, timeout);
+			break;
+		}
+		case TraceOp::delete_sync: {
+			auto it = syncs_.find(trace_.get<uint64_t>());
+			if(it != syncs_.end()) {
+				glDeleteSync(it->second);
+				syncs_.erase(it);
+			}
+			break;
+		}
+		case TraceOp::map_buffer_range: {
+			GLenum target = trace_.get<GLenum>();
+			GLintptr offset = GLintptr(trace_.get<uint64_t>());
+			GLsizeiptr length = GLsizeiptr(trace_.get<uint64_t>());
+			glMapBufferRange(target, offset, length, trace_.get<GLbitfield>());
+			break;
+		}
+		case TraceOp::unmap_buffer:
+			glUnmapBuffer(trace_.get<GLenum>());
+			break;
+		default:
+			break;
+		}
+	}
+
+public:
+	Replayer(TraceReader & trace, bool finish_each_call)
+		: trace_(trace), finish_each_call_(finish_each_call), program_(0),
+		  framebuffer_(0), color_(0), depth_(0)
+	{ }
+	Replayer(Replayer const &) = delete;
+	~Replayer() {
+		glDeleteFramebuffers(1, &framebuffer_);
+		glDeleteRenderbuffers(1, &color_);
+		glDeleteRenderbuffers(1, &depth_);
+	}
+
+	// replays from the current position to the end of the trace.  returns
+	// the number of frames and appends the time of each, up to its glFinish
+	size_t run(bool setup, std::vector<double> & frame_seconds, size_t & first_frame_end) {
+		size_t frames = 0;
+		auto frame_started = clock::now();
+
+		TraceOp op;
+		while(trace_.next(op)) {
+			if(op == TraceOp::frame_end) {
+				glFinish();
+				auto now = clock::now();
+				frame_seconds.push_back(std::chrono::duration<double>(now - frame_started).count());
+				frame_started = now;
+				if(frames++ == 0 && setup) first_frame_end = trace_.tell();
+				continue;
+			}
+			if(uint32_t(op) >= uint32_t(TraceOp::op_count)) {
+				cerr << "skipping unknown record " << uint32_t(op) << "\n";
+				continue;
+			}
+
+			auto started = clock::now();
+			execute(op, setup);
+			if(finish_each_call_) glFinish();
+			op_time & t = times_[size_t(op)];
+			t.calls++;
+			t.seconds += std::chrono::duration<double>(clock::now() - started).count();
+		}
+		return frames;
+	}
+
+	void print_times(FILE * out = stdout) const {
+		std::vector<size_t> order;
+		for(size_t i = 1; i < times_.size(); i++) if(times_[i].calls > 0) order.push_back(i);
+		std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return times_[a].seconds > times_[b].seconds; });
+
+		fprintf(out, "%-20s %10s %12s %12s\n", "call", "count", "total ms", "mean us");
+		for(size_t i : order) {
+			fprintf(out, "%-20s %10zu %12.3f %12.3f\n", op_names[i], times_[i].calls,
+			        times_[i].seconds * 1e3, times_[i].seconds / times_[i].calls * 1e6);
+		}
+	}
+};
+
+int main(int ac, char * av[]) {
+	string trace_path;
+	size_t loops = 1;
+	bool finish_each_call = false;
+
+	options_description desc("options");
+	desc.add_options()
+		("help,h", "prints this message")
+		("trace", value(&trace_path), "trace recorded with gl_planets --trace")
+		("loops", value(&loops), "times to replay the recorded frames, after the first pass")
+		("finish-each-call", bool_switch(&finish_each_call), "glFinish after every call, so per call times include the GPU work")
+	;
+	positional_options_description positional;
+	positional.add("trace", 1);
+
+	variables_map vm;
+	store(command_line_parser(ac, av).options(desc).positional(positional).run(), vm);
+
+	if(vm.count("help") || !vm.count("trace")) {
+		cout << "usage: gl_planets_replay [options] TRACE\n" << desc << "\n";
+		return vm.count("help") ? 0 : -1;
+	}
+
+	notify(vm);
+
+	TraceReader trace;
+	if(!trace.open(trace_path)) {
+		cerr << "'" << trace_path << "' is not a gl_planets trace\n";
+		return -1;
+	}
+
+	if (!glfwInit())
+	{
+		fprintf(stderr, "Error: Failed to init GLFW\n");
+		return -1;
+	}
+	glfwSetErrorCallback(error_callback);
+
+	// same kind of context as gl_planets, with a surface nobody sees
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	auto window = glfwCreateWindow(64, 64, "GL Planets replay", NULL, NULL);
+	if (!window)
+	{
+		fprintf(stderr, "Error: Failed to create window\n");
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0);
+
+	glewExperimental = GL_TRUE;
+	glewInit();
+
+	printf("replaying %zu bytes on \"%s\"\n", trace.size(), glGetString(GL_RENDERER));
+
+	{
+		Replayer replayer(trace, finish_each_call);
+		std::vector<double> setup_frames, frame_seconds;
+		size_t first_frame_end = 0;
+
+		auto started = std::chrono::steady_clock::now();
+		size_t frames = replayer.run(true, setup_frames, first_frame_end);
+		double setup = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+		printf("first pass: %zu frames in %.1fms, frame 0 (uploads and programs) %.1fms\n",
+		    frames, setup * 1e3, setup_frames.empty() ? 0. : setup_frames[0] * 1e3);
+
+		// frame 0 holds the one-off setup, the steady state is everything after it
+		frame_seconds.assign(setup_frames.begin() + std::min<size_t>(1, setup_frames.size()), setup_frames.end());
+		for(size_t loop = 1; loop < loops && first_frame_end != 0; loop++) {
+			trace.seek(first_frame_end);
+			replayer.run(false, frame_seconds, first_frame_end);
+		}
+
+		if(!frame_seconds.empty()) {
+			double total = 0.;
+			for(double s : frame_seconds) total += s;
+			std::sort(frame_seconds.begin(), frame_seconds.end());
+			printf("%zu frames in %.1fms = %.1f frames/s, frame p50 %.3fms p99 %.3fms max %.3fms\n",
+			    frame_seconds.size(), total * 1e3, frame_seconds.size() / total,
+			    frame_seconds[frame_seconds.size() / 2] * 1e3,
+			    frame_seconds[frame_seconds.size() * 99 / 100] * 1e3,
+			    frame_seconds.back() * 1e3);
+		}
+		printf("\nper call cpu time%s:\n", finish_each_call ? " including the gpu" : "");
+		replayer.print_times();
+	}
+
+	glfwMakeContextCurrent(NULL);
+	glfwDestroyWindow(window);
+	glfwTerminate();
+
+	return 0;
+}
@@ -0,0 +1,94 @@
+// sample consumer for the frames gl_planets publishes with --shm-output.
+// maps the ring read-only, follows the newest frame and reports how far
+// behind the renderer it is, without copying any pixels.
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+
+#include "shm_ring.hpp"
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using std::cout;
+using std::cerr;
+using std::string;
+
+int main(int ac, char * av[]) {
+	string name = "/gl_planets";
+	double seconds = 0.;
+
+	options_description desc("options");
+	desc.add_options()
+		("help,h", "prints this message")
+		("name,n", value(&name), "shared memory object to read")
+		("seconds", value(&seconds), "stop after this long, 0 to run forever")
+	;
+	variables_map vm;
+	store(parse_command_line(ac, av, desc), vm);
+
+	if(vm.count("help")) {
+		cout << desc << "\n";
+		return 0;
+	}
+
+	notify(vm);
+
+	ShmRingReader ring;
+	while(!ring.open(name)) {
+		cerr << "waiting for '" << name << "'\n";
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+
+	auto started = std::chrono::steady_clock::now();
+	auto last_report = started;
+	uint64_t last = 0;
+	uint64_t consumed = 0, skipped = 0, torn = 0;
+	std::vector<double> latencies_ms;
+	unsigned checksum = 0;
+	uint32_t width = 0, height = 0;
+
+	for(;;) {
+		ShmFrame frame;
+		if(!ring.acquire(frame, last)) {
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		} else {
+			// touch one byte per cache line, in place
+			size_t size = size_t(frame.stride) * frame.height;
+			for(size_t i = 0; i < size; i += 64) checksum += frame.pixels[i];
+
+			if(!ring.still_valid(frame)) {
+				torn++;
+			} else {
+				if(last != 0) skipped += frame.sequence - last - 1;
+				last = frame.sequence;
+				width = frame.width;
+				height = frame.height;
+				consumed++;
+				latencies_ms.push_back((monotonic_ns() - frame.timestamp_ns) * 1e-6);
+			}
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if(now - last_report >= std::chrono::seconds(1) && !latencies_ms.empty()) {
+			std::sort(latencies_ms.begin(), latencies_ms.end());
+			printf("frame %llu %ux%u: %llu consumed, %llu skipped, %llu torn, latency p50 %.2fms p99 %.2fms (checksum %08x)\n",
+			    (unsigned long long)last, width, height,
+			    (unsigned long long)consumed, (unsigned long long)skipped, (unsigned long long)torn,
+			    latencies_ms[latencies_ms.size() / 2],
+			    latencies_ms[latencies_ms.size() * 99 / 100],
+			    checksum);
+			latencies_ms.clear();
+			last_report = now;
+		}
+
+		if(seconds > 0. && now - started >= std::chrono::duration<double>(seconds)) break;
+	}
+
+	return 0;
+}
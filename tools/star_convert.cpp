@@ -0,0 +1,129 @@
+// builds the memory-mapped star catalog gl_planets reads with --star-catalog.
+// takes a delimited text catalog (Hipparcos, Tycho-2 or anything with right
+// ascension and declination in degrees, a visual magnitude and optionally a
+// B-V index per line), or makes a synthetic sky of any size for testing.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdio>
+
+#include "star_catalog.hpp"
+
+#include <boost/program_options.hpp>
+using namespace boost::program_options;
+
+using std::cout;
+using std::cerr;
+using std::string;
+
+// same orientation as the equirectangular starfield: y towards the north
+// celestial pole, right ascension 0 straight ahead along z and increasing
+// to the left
+static catalog_star make_star(double ra_degrees, double dec_degrees, float magnitude, float color) {
+	double ra = ra_degrees * glm::pi<double>() / 180.;
+	double dec = dec_degrees * glm::pi<double>() / 180.;
+	return { float(-std::cos(dec) * std::sin(ra)), float(std::sin(dec)), float(std::cos(dec) * std::cos(ra)),
+	         magnitude, color };
+}
+
+int main(int ac, char * av[]) {
+	string input, output = "stars.bin";
+	char delimiter = '|';
+	int ra_column = 0, dec_column = 1, magnitude_column = 2, color_column = -1;
+	size_t skip = 0;
+	size_t synthetic = 0;
+	uint32_t resolution = 32;
+
+	options_description desc("options");
+	desc.add_options()
+		("help,h", "prints this message")
+		("input,i", value(&input), "delimited text catalog to convert")
+		("output,o", value(&output), "catalog file to write")
+		("delimiter", value(&delimiter), "field separator of the input")
+		("skip", value(&skip), "header lines to skip")
+		("ra-column", value(&ra_column), "field holding right ascension in degrees, from 0")
+		("dec-column", value(&dec_column), "field holding declination in degrees")
+		("magnitude-column", value(&magnitude_column), "field holding the visual magnitude")
+		("color-column", value(&color_column), "field holding the B-V index, -1 if there is none")
+		("synthetic", value(&synthetic), "instead of reading a catalog, scatter this many random stars")
+		("resolution", value(&resolution), "sky index cells along each cube face edge")
+	;
+	variables_map vm;
+	store(parse_command_line(ac, av, desc), vm);
+
+	if(vm.count("help")) {
+		cout << desc << "\n";
+		return 0;
+	}
+
+	notify(vm);
+
+	if(input.empty() && synthetic == 0) {
+		cerr << "need an --input catalog or --synthetic stars\n";
+		return -1;
+	}
+
+	auto started = std::chrono::steady_clock::now();
+	std::vector<catalog_star> stars;
+	size_t rejected = 0;
+
+	if(synthetic > 0) {
+		// the number of stars brighter than m grows about 10^(0.5 m) for the
+		// bright end of real catalogs, which this follows down to magnitude 12
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<double> unit(0., 1.);
+		std::normal_distribution<float> color(0.6f, 0.4f);
+		stars.reserve(synthetic);
+		for(size_t i = 0; i < synthetic; i++) {
+			double ra = 360. * unit(rng);
+			double dec = std::asin(2. * unit(rng) - 1.) * 180. / glm::pi<double>();
+			float magnitude = std::max(-1.5f, float(12. + 2. * std::log10(1. - unit(rng))));
+			stars.push_back(make_star(ra, dec, magnitude, color(rng)));
+		}
+	} else {
+		std::ifstream in(input);
+		if(!in) {
+			cerr << "could not open '" << input << "'\n";
+			return -1;
+		}
+
+		string line, field;
+		std::vector<string> fields;
+		for(size_t n = 0; std::getline(in, line); n++) {
+			if(n < skip) continue;
+
+			fields.clear();
+			std::istringstream ss(line);
+			while(std::getline(ss, field, delimiter)) fields.push_back(field);
+
+			auto number = [&](int column, double & value) {
+				if(column < 0 || column >= (int)fields.size()) return false;
+				char * end;
+				value = std::strtod(fields[column].c_str(), &end);
+				return end != fields[column].c_str();
+			};
+			double ra, dec, magnitude, color = 0.6;
+			if(!number(ra_column, ra) || !number(dec_column, dec) || !number(magnitude_column, magnitude)) {
+				rejected++;
+				continue;
+			}
+			if(color_column >= 0 && !number(color_column, color)) color = 0.6;
+			stars.push_back(make_star(ra, dec, float(magnitude), float(color)));
+		}
+	}
+	double parsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	if(!StarCatalog::write(output, stars, resolution)) {
+		return -1;
+	}
+	double written = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+	printf("%zu stars (%zu lines rejected) into %u cells in '%s', read in %.2fs, written in %.2fs\n",
+	    stars.size(), rejected, 6 * resolution * resolution, output.c_str(), parsed, written - parsed);
+	return 0;
+}